@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Microbenchmarks for the hot kernels of svg2pes.  All inputs are
+ * generated from a fixed seed, so the numbers of different commits
+ * are comparable.
+ */
+
+#include "SvgParser.hxx"
+#include "SvgData.hxx"
+#include "SvgBezier.hxx"
+#include "SvgArc.hxx"
+#include "SvgTransform.hxx"
+#include "CssParser.hxx"
+#include "CssColor.hxx"
+#include "PesColor.hxx"
+#include "PesWriter.hxx"
+#include "Color.hxx"
+#include "XorShiftRandom.hxx"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+class Random : public XorShiftRandom {
+public:
+	SvgPoint NextPoint(double size) noexcept {
+		return {Next(0., size), Next(0., size)};
+	}
+};
+
+/**
+ * Results are written here so the compiler cannot omit the
+ * calculation.
+ */
+volatile size_t sink;
+
+struct Workload {
+	/**
+	 * The number of operations and input bytes processed by one
+	 * call of the kernel.
+	 */
+	size_t ops, bytes;
+};
+
+/**
+ * Run the given function repeatedly and return the duration of the
+ * fastest call in nanoseconds.  The number of calls per sample is
+ * chosen so a sample takes at least 20 ms, which hides the
+ * resolution of the clock.
+ */
+template<typename F>
+double
+Measure(F &&f)
+{
+	using clock = std::chrono::steady_clock;
+
+	/* warm up caches and allocators */
+	f();
+
+	auto sample = [&f](unsigned n){
+		const auto start = clock::now();
+		for (unsigned i = 0; i < n; ++i)
+			f();
+		return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+	};
+
+	unsigned n = 1;
+	while (sample(n) < 20e6 && n < (1u << 30))
+		n *= 2;
+
+	double best = sample(n);
+	for (unsigned i = 1; i < 5; ++i)
+		best = std::min(best, sample(n));
+
+	return best / n;
+}
+
+void
+Report(const char *name, double ns, Workload w)
+{
+	printf("%-12s %12.1f ns/op", name, ns / w.ops);
+	if (w.bytes > 0)
+		printf(" %10.1f MB/s", w.bytes * 1e3 / ns);
+	printf("\n");
+}
+
+/**
+ * Parse a document with one long path, which exercises the path
+ * data parser and ParseDouble().
+ */
+void
+BenchPath(const char *name)
+{
+	Random random;
+
+	std::string d;
+	char buffer[256];
+	size_t n_commands = 0;
+	while (n_commands < 10000) {
+		SvgPoint a = random.NextPoint(1000), b = random.NextPoint(1000),
+			c = random.NextPoint(1000);
+		switch (random.Next(4)) {
+		case 0:
+			snprintf(buffer, sizeof(buffer), "M%.3f,%.3f ", a.x, a.y);
+			break;
+
+		case 1:
+			snprintf(buffer, sizeof(buffer), "l %.2f %.2f ",
+				 a.x - 500, a.y - 500);
+			break;
+
+		case 2:
+			snprintf(buffer, sizeof(buffer),
+				 "C%.3f,%.3f %.3f,%.3f %.3f,%.3f ",
+				 a.x, a.y, b.x, b.y, c.x, c.y);
+			break;
+
+		case 3:
+			snprintf(buffer, sizeof(buffer),
+				 "a%.1f %.1f %.0f %u %u %.2f %.2f ",
+				 a.x / 10 + 1, a.y / 10 + 1, b.x,
+				 random.Next(2), random.Next(2),
+				 c.x - 500, c.y - 500);
+			break;
+		}
+
+		d += buffer;
+		++n_commands;
+	}
+
+	const std::string document =
+		"<svg xmlns='http://www.w3.org/2000/svg' width='1000' height='1000'>"
+		"<path fill='red' d='" + d + "'/></svg>";
+
+	const double ns = Measure([&document](){
+			SvgParser parser;
+			parser.DisableCulling();
+			parser.Parse(document.data(), document.length(), true);
+			sink = parser.GetStats().vertices;
+		});
+
+	Report(name, ns, {n_commands, d.length()});
+}
+
+void
+BenchCubic(const char *name)
+{
+	Random random;
+
+	std::vector<SvgPoint> input(4096);
+	for (auto &i : input)
+		i = random.NextPoint(1000);
+
+	std::vector<SvgVertex> dest;
+
+	const size_t n = input.size() - 3;
+	const double ns = Measure([&](){
+			dest.clear();
+			for (size_t i = 0; i < n; ++i)
+				SvgCubicBezierToLines(dest, input[i], input[i + 1],
+						      input[i + 2], input[i + 3]);
+			sink = dest.size();
+		});
+
+	Report(name, ns, {n, 0});
+}
+
+void
+BenchArc(const char *name)
+{
+	struct Arc {
+		SvgPoint start, radius, end;
+		double rotation;
+		bool large_arc, sweep;
+	};
+
+	Random random;
+
+	std::vector<Arc> input(4096);
+	for (auto &i : input)
+		i = {random.NextPoint(1000), random.NextPoint(500),
+		     random.NextPoint(1000), random.Next(0., 360.),
+		     random.Next(2) != 0, random.Next(2) != 0};
+
+	std::vector<SvgVertex> dest;
+
+	const double ns = Measure([&](){
+			dest.clear();
+			for (const auto &i : input)
+				SvgArcToLines(dest, i.start, i.radius, i.rotation,
+					      i.large_arc, i.sweep, i.end);
+			sink = dest.size();
+		});
+
+	Report(name, ns, {input.size(), 0});
+}
+
+void
+BenchTransform(const char *name)
+{
+	Random random;
+
+	const SvgMatrix matrix =
+		ParseSvgTransform("translate(12.5,-3) rotate(30) scale(0.75 1.25) skewX(5)");
+
+	const auto input = [&random](){
+		std::vector<SvgVertex> points;
+		points.reserve(65536);
+		while (points.size() < 65536)
+			points.emplace_back(SvgVertex::Type::LINE,
+					    random.NextPoint(1000));
+		return points;
+	}();
+
+	/* transforming in place would compound the matrix on each
+	   iteration, and the values would drift towards infinity or
+	   zero */
+	std::vector<SvgVertex> output(input);
+
+	const double ns = Measure([&](){
+			for (size_t i = 0; i < input.size(); ++i)
+				(SvgPoint &)output[i] = matrix * input[i];
+			sink = size_t(output.front().x);
+		});
+
+	Report(name, ns, {input.size(), input.size() * sizeof(SvgVertex)});
+}
+
+void
+BenchCss(const char *name)
+{
+	Random random;
+
+	static constexpr const char *properties[] = {
+		"fill:#%06x", "stroke:#%06x", "stroke-width:%.2f",
+		"opacity:%.2f", "fill-opacity:%.2f", "fill-rule:evenodd",
+		"stroke-linecap:round", "display:inline",
+	};
+
+	std::vector<std::string> input(1024);
+	size_t bytes = 0;
+	for (auto &i : input) {
+		const unsigned n = 1 + random.Next(6);
+		for (unsigned j = 0; j < n; ++j) {
+			const char *format = properties[random.Next(8)];
+			char buffer[64];
+			if (strstr(format, "%06x") != nullptr)
+				snprintf(buffer, sizeof(buffer), format,
+					 random.Next(0x1000000));
+			else
+				snprintf(buffer, sizeof(buffer), format,
+					 random.Next(0., 4.));
+
+			if (!i.empty())
+				i += ';';
+			i += buffer;
+		}
+
+		bytes += i.length();
+	}
+
+	const double ns = Measure([&input](){
+			size_t n = 0;
+			for (const auto &i : input)
+				n += ParseCss(i.c_str()).size();
+			sink = n;
+		});
+
+	Report(name, ns, {input.size(), bytes});
+}
+
+void
+BenchColor(const char *name)
+{
+	Random random;
+
+	static constexpr const char *keywords[] = {
+		"black", "white", "red", "steelblue", "yellowgreen",
+		"darkslategray",
+	};
+
+	std::vector<std::string> input(4096);
+	size_t bytes = 0;
+	for (auto &i : input) {
+		char buffer[16];
+		switch (random.Next(3)) {
+		case 0:
+			snprintf(buffer, sizeof(buffer), "#%06x",
+				 random.Next(0x1000000));
+			break;
+
+		case 1:
+			snprintf(buffer, sizeof(buffer), "#%03x",
+				 random.Next(0x1000));
+			break;
+
+		case 2:
+			snprintf(buffer, sizeof(buffer), "%s",
+				 keywords[random.Next(6)]);
+			break;
+		}
+
+		i = buffer;
+		bytes += i.length();
+	}
+
+	const double ns = Measure([&input](){
+			unsigned n = 0;
+			for (const auto &i : input)
+				n += ParseCssColor(i.c_str()).r;
+			sink = n;
+		});
+
+	Report(name, ns, {input.size(), bytes});
+}
+
+void
+BenchNearestColor(const char *name)
+{
+	Random random;
+
+	std::vector<Color> input(4096);
+	for (auto &i : input)
+		i = {uint8_t(random.Next(256)), uint8_t(random.Next(256)),
+		     uint8_t(random.Next(256))};
+
+	const double ns = Measure([&input](){
+			unsigned n = 0;
+			for (const auto &i : input)
+				n += NearestPesColor(i);
+			sink = n;
+		});
+
+	Report(name, ns, {input.size(), 0});
+}
+
+void
+BenchStitchLine(const char *name)
+{
+	Random random;
+
+	/* mostly short stitches as generated by the stitchers, some
+	   long ones and a few which need to be split */
+	struct Delta { int x, y; };
+	std::vector<Delta> input(65536);
+	for (auto &i : input) {
+		const unsigned kind = random.Next(16);
+		const int range = kind < 12 ? 64 : (kind < 15 ? 2048 : 8192);
+		i = {int(random.Next(2 * range)) - range,
+		     int(random.Next(2 * range)) - range};
+	}
+
+	PesWriter writer;
+
+	size_t bytes = 0;
+	const double ns = Measure([&](){
+			writer.Clear();
+			for (const auto &i : input)
+				writer.StitchLine(i.x, i.y);
+			bytes = writer.GetData().size;
+			sink = bytes;
+		});
+
+	Report(name, ns, {input.size(), bytes});
+}
+
+constexpr struct {
+	const char *name;
+	void (*function)(const char *name);
+} benchmarks[] = {
+	{"path", BenchPath},
+	{"cubic", BenchCubic},
+	{"arc", BenchArc},
+	{"transform", BenchTransform},
+	{"css", BenchCss},
+	{"color", BenchColor},
+	{"nearest", BenchNearestColor},
+	{"stitchline", BenchStitchLine},
+};
+
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2) {
+		for (const auto &i : benchmarks)
+			i.function(i.name);
+		return EXIT_SUCCESS;
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		bool found = false;
+		for (const auto &b : benchmarks) {
+			if (strcmp(argv[i], b.name) == 0) {
+				b.function(b.name);
+				found = true;
+				break;
+			}
+		}
+
+		if (!found) {
+			fprintf(stderr, "Unknown benchmark: %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	fprintf(stderr, "%s\n", e.what());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "Compiler.h"
+
+/**
+ * The phases of a conversion, which are timed separately.
+ */
+enum class ConversionPhase : unsigned {
+	/**
+	 * Reading and parsing the SVG file, including tessellation
+	 * and transformation.
+	 */
+	PARSE,
+
+	/**
+	 * Generating stitches for all paths.
+	 */
+	STITCH,
+
+	/**
+	 * Grouping the layers into color blocks.
+	 */
+	SCHEDULE,
+
+	/**
+	 * Ordering the runs and encoding the PES stitch data.
+	 */
+	ENCODE,
+
+	/**
+	 * Writing the output file.
+	 */
+	WRITE,
+
+	N
+};
+
+gcc_const
+const char *
+GetPhaseName(ConversionPhase phase) noexcept;
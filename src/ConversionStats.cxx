@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ConversionStats.hxx"
+
+static constexpr const char *phase_names[] = {
+	"parse",
+	"stitch",
+	"schedule",
+	"encode",
+	"write",
+};
+
+static_assert(sizeof(phase_names) / sizeof(phase_names[0]) ==
+	      size_t(ConversionPhase::N), "");
+
+const char *
+GetPhaseName(ConversionPhase phase) noexcept
+{
+	return phase_names[size_t(phase)];
+}
+
+void
+ConversionStats::Print(FILE *file, bool json) const
+{
+	const struct {
+		const char *name;
+		unsigned long value;
+	} counters[] = {
+		{"elements", parser.elements},
+		{"paths", parser.paths},
+		{"vertices", parser.vertices},
+		{"curves", parser.curves},
+		{"runs", runs},
+		{"blocks", blocks},
+		{"stitches", sewing.stitches},
+		{"jumps", sewing.jumps},
+		{"trims", sewing.trims},
+		{"manual_trims", sewing.manual_trims},
+		{"color_changes", sewing.color_changes},
+		{"output_bytes", output_bytes},
+	};
+
+	double total = 0;
+	for (double i : seconds)
+		total += i;
+
+	if (json) {
+		fputs("{\"seconds\":{", file);
+		for (size_t i = 0; i < seconds.size(); ++i)
+			fprintf(file, "\"%s\":%.6f,",
+				phase_names[i], seconds[i]);
+		fprintf(file, "\"total\":%.6f}", total);
+
+		for (const auto &i : counters)
+			fprintf(file, ",\"%s\":%lu", i.name, i.value);
+		fputs("}\n", file);
+	} else {
+		for (size_t i = 0; i < seconds.size(); ++i)
+			fprintf(file, "%s_seconds = %.6f\n",
+				phase_names[i], seconds[i]);
+		fprintf(file, "total_seconds = %.6f\n", total);
+
+		for (const auto &i : counters)
+			fprintf(file, "%s = %lu\n", i.name, i.value);
+	}
+}
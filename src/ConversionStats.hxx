@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "ConversionPhase.hxx"
+#include "MemoryStats.hxx"
+#include "SvgParser.hxx"
+#include "SewingCost.hxx"
+#include "Trace.hxx"
+
+#include <array>
+#include <chrono>
+
+#include <stdio.h>
+
+/**
+ * Timers and counters describing one conversion, for finding out
+ * where the time goes.
+ */
+struct ConversionStats {
+	/**
+	 * The wall time spent in each phase [seconds].
+	 */
+	std::array<double, size_t(ConversionPhase::N)> seconds{};
+
+	SvgParserStats parser;
+
+	/**
+	 * The number of runs and color blocks.
+	 */
+	unsigned long runs = 0, blocks = 0;
+
+	SewingEstimate sewing;
+
+	size_t output_bytes = 0;
+
+	/**
+	 * Print the report as "name = value" lines or as one JSON
+	 * object.
+	 */
+	void Print(FILE *file, bool json) const;
+};
+
+/**
+ * Adds the time from construction to destruction to one phase of a
+ * #ConversionStats object, and records it as a trace span.
+ */
+class ScopePhaseTimer {
+	typedef std::chrono::steady_clock Clock;
+
+	TraceSpan span;
+	ScopeMemoryPhase memory_phase;
+
+	double &dest;
+	const Clock::time_point start;
+
+public:
+	ScopePhaseTimer(ConversionStats &stats, ConversionPhase phase)
+		:span("phase", GetPhaseName(phase)), memory_phase(phase),
+		 dest(stats.seconds[size_t(phase)]), start(Clock::now()) {}
+
+	~ScopePhaseTimer() {
+		dest += std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	ScopePhaseTimer(const ScopePhaseTimer &) = delete;
+	ScopePhaseTimer &operator=(const ScopePhaseTimer &) = delete;
+};
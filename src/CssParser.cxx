@@ -48,6 +48,10 @@ NextCssValue(const char *&s) noexcept
 	if (semicolon == nullptr)
 		semicolon = s + strlen(s);
 	s = semicolon;
+
+	while (semicolon > value && semicolon[-1] == ' ')
+		--semicolon;
+
 	return std::string(value, semicolon);
 }
 
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "CssStylesheet.hxx"
+#include "CssParser.hxx"
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace {
+
+constexpr bool
+IsCssIdentifierChar(char ch) noexcept
+{
+	return (ch >= 'a' && ch <= 'z') ||
+		(ch >= 'A' && ch <= 'Z') ||
+		(ch >= '0' && ch <= '9') ||
+		ch == '-' || ch == '_';
+}
+
+/**
+ * Copy the style sheet, dropping comments and converting all
+ * whitespace to spaces (which is what ParseCss() expects).
+ */
+std::string
+Normalize(const char *s)
+{
+	std::string result;
+	result.reserve(strlen(s));
+
+	while (*s != 0) {
+		if (s[0] == '/' && s[1] == '*') {
+			const char *end = strstr(s + 2, "*/");
+			if (end == nullptr)
+				break;
+			s = end + 2;
+			result.push_back(' ');
+			continue;
+		}
+
+		const char ch = *s++;
+		result.push_back(ch == '\t' || ch == '\n' || ch == '\r'
+				 ? ' ' : ch);
+	}
+
+	return result;
+}
+
+/**
+ * Skip an at-rule such as "@import" or "@media".
+ */
+const char *
+SkipAtRule(const char *s)
+{
+	while (*s != 0 && *s != ';' && *s != '{')
+		++s;
+
+	if (*s == ';')
+		return s + 1;
+
+	unsigned depth = 0;
+	for (; *s != 0; ++s) {
+		if (*s == '{')
+			++depth;
+		else if (*s == '}' && --depth == 0)
+			return s + 1;
+	}
+
+	return s;
+}
+
+std::string
+Trim(const char *begin, const char *end)
+{
+	while (begin < end && *begin == ' ')
+		++begin;
+	while (end > begin && end[-1] == ' ')
+		--end;
+	return std::string(begin, end);
+}
+
+/**
+ * Parse a declaration block.  "!important" is ignored.
+ */
+std::map<std::string, std::string>
+ParseDeclarations(const std::string &block)
+{
+	auto result = ParseCss(block.c_str());
+	for (auto &i : result) {
+		auto important = i.second.find("!important");
+		if (important != std::string::npos)
+			i.second = Trim(i.second.data(),
+					i.second.data() + important);
+	}
+
+	return result;
+}
+
+const char *
+NextIdentifier(const char *s, std::string &dest)
+{
+	const char *start = s;
+	while (IsCssIdentifierChar(*s))
+		++s;
+	dest.assign(start, s);
+	return s;
+}
+
+void
+SplitClasses(std::vector<std::string> &dest, const char *s)
+{
+	dest.clear();
+
+	while (true) {
+		while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+			++s;
+		if (*s == 0)
+			break;
+
+		const char *start = s;
+		while (*s != 0 && *s != ' ' && *s != '\t' &&
+		       *s != '\n' && *s != '\r')
+			++s;
+		dest.emplace_back(start, s);
+	}
+}
+
+}
+
+bool
+CssStylesheet::AddRule(const char *selector, unsigned block)
+{
+	Rule rule;
+	rule.block = block;
+
+	const char *s = selector;
+	if (*s == '*')
+		++s;
+	else
+		s = NextIdentifier(s, rule.tag);
+
+	unsigned n_ids = 0;
+	while (*s != 0) {
+		std::string name;
+		if (*s == '.') {
+			s = NextIdentifier(s + 1, name);
+			if (name.empty())
+				return false;
+			rule.classes.push_back(std::move(name));
+		} else if (*s == '#') {
+			s = NextIdentifier(s + 1, name);
+			if (name.empty() || !rule.id.empty())
+				return false;
+			rule.id = std::move(name);
+			++n_ids;
+		} else
+			/* combinators, attribute selectors and
+			   pseudo-classes are not supported */
+			return false;
+	}
+
+	rule.specificity = (n_ids << 20) | (unsigned(rule.classes.size()) << 10) |
+		!rule.tag.empty();
+
+	const unsigned index = rules.size();
+	if (!rule.id.empty())
+		by_id[rule.id].push_back(index);
+	else if (!rule.classes.empty())
+		by_class[rule.classes.front()].push_back(index);
+	else if (!rule.tag.empty())
+		by_tag[rule.tag].push_back(index);
+	else
+		universal.push_back(index);
+
+	rules.push_back(std::move(rule));
+	return true;
+}
+
+void
+CssStylesheet::Parse(const char *_s)
+{
+	const std::string text = Normalize(_s);
+	const char *s = text.c_str();
+
+	while (true) {
+		while (*s == ' ')
+			++s;
+		if (*s == 0)
+			break;
+
+		/* XML comment delimiters are allowed around the style
+		   sheet for ancient browsers */
+		if (strncmp(s, "<!--", 4) == 0 || strncmp(s, "-->", 3) == 0) {
+			s += *s == '<' ? 4 : 3;
+			continue;
+		}
+
+		if (*s == '@') {
+			s = SkipAtRule(s);
+			continue;
+		}
+
+		const char *open = strchr(s, '{');
+		if (open == nullptr)
+			break;
+
+		const char *close = strchr(open, '}');
+		if (close == nullptr)
+			close = open + strlen(open);
+
+		const unsigned block = blocks.size();
+		blocks.push_back(ParseDeclarations(std::string(open + 1, close)));
+
+		/* a selector list shares one declaration block */
+		while (s < open) {
+			const char *comma = std::find(s, open, ',');
+			AddRule(Trim(s, comma).c_str(), block);
+			s = comma < open ? comma + 1 : open;
+		}
+
+		s = *close != 0 ? close + 1 : close;
+	}
+}
+
+inline bool
+CssStylesheet::Matches(const Rule &rule,
+		       const char *tag, const char *id) const
+{
+	if (!rule.tag.empty() && rule.tag != tag)
+		return false;
+
+	if (!rule.id.empty() && (id == nullptr || rule.id != id))
+		return false;
+
+	for (const auto &i : rule.classes)
+		if (std::find(element_classes.begin(), element_classes.end(),
+			      i) == element_classes.end())
+			return false;
+
+	return true;
+}
+
+void
+CssStylesheet::MatchIndex(const Index &index, const std::string &key,
+			  const char *tag, const char *id,
+			  std::vector<unsigned> &result) const
+{
+	auto i = index.find(key);
+	if (i == index.end())
+		return;
+
+	for (unsigned rule : i->second)
+		if (Matches(rules[rule], tag, id))
+			result.push_back(rule);
+}
+
+void
+CssStylesheet::Match(const char *tag, const char *id, const char *classes,
+		     std::vector<unsigned> &result) const
+{
+	result.clear();
+	if (rules.empty())
+		return;
+
+	if (classes != nullptr)
+		SplitClasses(element_classes, classes);
+	else
+		element_classes.clear();
+
+	if (id != nullptr)
+		MatchIndex(by_id, id, tag, id, result);
+
+	for (const auto &i : element_classes)
+		MatchIndex(by_class, i, tag, id, result);
+
+	MatchIndex(by_tag, tag, tag, id, result);
+
+	for (unsigned rule : universal)
+		if (Matches(rules[rule], tag, id))
+			result.push_back(rule);
+
+	/* duplicate classes in the attribute may have added a rule
+	   twice */
+	std::sort(result.begin(), result.end(), [this](unsigned a, unsigned b){
+			const unsigned sa = rules[a].specificity;
+			const unsigned sb = rules[b].specificity;
+			return sa != sb ? sa < sb : a < b;
+		});
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+const char *
+CssStylesheet::Get(unsigned rule, const char *name) const
+{
+	const auto &declarations = blocks[rules[rule].block];
+	auto i = declarations.find(name);
+	return i != declarations.end() ? i->second.c_str() : nullptr;
+}
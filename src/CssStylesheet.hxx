@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * The rules of CSS style sheets (from "style" elements).  Only simple
+ * selectors (type, class, id and combinations thereof) are
+ * supported; rules with other selectors are ignored.
+ *
+ * Each rule is indexed by its id, one of its classes or its type, so
+ * matching an element only looks at rules which may apply to it.
+ */
+class CssStylesheet {
+	typedef std::map<std::string, std::string> Declarations;
+
+	struct Rule {
+		std::string tag, id;
+		std::vector<std::string> classes;
+
+		/**
+		 * Encodes the selector's specificity; a higher value
+		 * takes precedence.
+		 */
+		unsigned specificity;
+
+		/**
+		 * Index into #blocks.
+		 */
+		unsigned block;
+	};
+
+	std::vector<Declarations> blocks;
+
+	/**
+	 * All rules in the order of appearance.
+	 */
+	std::vector<Rule> rules;
+
+	typedef std::unordered_map<std::string, std::vector<unsigned>> Index;
+	Index by_id, by_class, by_tag;
+
+	/**
+	 * Rules with the universal selector.
+	 */
+	std::vector<unsigned> universal;
+
+	/**
+	 * Scratch buffer for Match().
+	 */
+	mutable std::vector<std::string> element_classes;
+
+public:
+	bool IsEmpty() const {
+		return rules.empty();
+	}
+
+	/**
+	 * Add the rules of a style sheet.  Unsupported constructs are
+	 * skipped.
+	 */
+	void Parse(const char *s);
+
+	/**
+	 * Determine all rules which match the given element.
+	 *
+	 * @param id the "id" attribute or nullptr
+	 * @param classes the "class" attribute or nullptr
+	 * @param result receives the indices of the matching rules,
+	 * ordered by increasing precedence
+	 */
+	void Match(const char *tag, const char *id, const char *classes,
+		   std::vector<unsigned> &result) const;
+
+	/**
+	 * Look up a property in the given rule.
+	 *
+	 * @return the value or nullptr if the rule does not declare
+	 * it
+	 */
+	const char *Get(unsigned rule, const char *name) const;
+
+private:
+	bool AddRule(const char *selector, unsigned block);
+
+	bool Matches(const Rule &rule, const char *tag, const char *id) const;
+
+	void MatchIndex(const Index &index, const std::string &key,
+			const char *tag, const char *id,
+			std::vector<unsigned> &result) const;
+};
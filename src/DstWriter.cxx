@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "DstWriter.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+constexpr size_t DST_HEADER_SIZE = 512;
+
+/**
+ * The bits of one DST coordinate in the three bytes of a record.
+ */
+struct DstDelta {
+	uint8_t bytes[3] = {0, 0, 0};
+};
+
+/**
+ * Precomputed balanced ternary encodings of all coordinates
+ * (-121..121): each digit (81, 27, 9, 3, 1) is a "plus" and a
+ * "minus" bit somewhere in the record.
+ */
+struct DstDeltaTable {
+	DstDelta x[243], y[243];
+
+	struct Digit {
+		int value;
+
+		/**
+		 * The byte and bit positions for +value and -value, for
+		 * x and y.
+		 */
+		uint8_t x_byte, x_plus, x_minus;
+		uint8_t y_byte, y_plus, y_minus;
+	};
+
+	static constexpr Digit digits[5] = {
+		{81, 2, 2, 3, 2, 5, 4},
+		{27, 1, 2, 3, 1, 5, 4},
+		{9, 0, 2, 3, 0, 5, 4},
+		{3, 1, 0, 1, 1, 7, 6},
+		{1, 0, 0, 1, 0, 7, 6},
+	};
+
+	constexpr DstDeltaTable():x(), y() {
+		for (int i = 0; i < 243; ++i) {
+			int vx = i - 121, vy = vx;
+			for (const auto &d : digits) {
+				/* the largest remaining magnitude of the
+				   lower digits is (d.value - 1) / 2 */
+				const int half = d.value / 2;
+				if (vx > half) {
+					x[i].bytes[d.x_byte] |= 1 << d.x_plus;
+					vx -= d.value;
+				} else if (vx < -half) {
+					x[i].bytes[d.x_byte] |= 1 << d.x_minus;
+					vx += d.value;
+				}
+
+				if (vy > half) {
+					y[i].bytes[d.y_byte] |= 1 << d.y_plus;
+					vy -= d.value;
+				} else if (vy < -half) {
+					y[i].bytes[d.y_byte] |= 1 << d.y_minus;
+					vy += d.value;
+				}
+			}
+		}
+	}
+};
+
+constexpr DstDeltaTable::Digit DstDeltaTable::digits[5];
+
+constexpr DstDeltaTable dst_delta_table;
+
+}
+
+DstWriter::DstWriter(const char *_label)
+{
+	snprintf(label, sizeof(label), "%s", _label);
+	bounds.Extend(position);
+	ReserveHeader(DST_HEADER_SIZE);
+}
+
+void
+DstWriter::Record(int x, int y, uint8_t flags)
+{
+	assert(CheckDelta(x, y));
+
+	position.x += x;
+	position.y += y;
+	bounds.Extend(position);
+
+	/* the DST y axis points up */
+	const auto &dx = dst_delta_table.x[x + 121];
+	const auto &dy = dst_delta_table.y[121 - y];
+
+	uint8_t *p = buffer.PrepareWrite(3);
+	p[0] = dx.bytes[0] | dy.bytes[0];
+	p[1] = dx.bytes[1] | dy.bytes[1];
+	p[2] = dx.bytes[2] | dy.bytes[2] | 0x03 | flags;
+	buffer.CommitWrite(3);
+}
+
+void
+DstWriter::Command(uint8_t b2)
+{
+	uint8_t *p = buffer.PrepareWrite(3);
+	p[0] = 0;
+	p[1] = 0;
+	p[2] = b2;
+	buffer.CommitWrite(3);
+}
+
+ConstBuffer<uint8_t> DstWriter::Finish()
+{
+	End();
+
+	char header[DST_HEADER_SIZE + 1];
+	const int length =
+		snprintf(header, sizeof(header),
+			 "LA:%-16s\r"
+			 "ST:%7zu\r"
+			 "CO:%3u\r"
+			 "+X:%5d\r"
+			 "-X:%5d\r"
+			 "+Y:%5d\r"
+			 "-Y:%5d\r"
+			 "AX:%c%5d\r"
+			 "AY:%c%5d\r"
+			 "MX:+    0\r"
+			 "MY:+    0\r"
+			 "PD:******\r"
+			 "\x1a",
+			 label,
+			 (buffer.size() - DST_HEADER_SIZE) / 3,
+			 n_color_changes,
+			 bounds.max_x, -bounds.min_x,
+			 /* the DST y axis points up */
+			 -bounds.min_y, bounds.max_y,
+			 position.x < 0 ? '-' : '+', abs(position.x),
+			 position.y > 0 ? '-' : '+', abs(position.y));
+	assert(length > 0 && size_t(length) < DST_HEADER_SIZE);
+
+	/* the rest of the header is padded with spaces */
+	memset(header + length, ' ', DST_HEADER_SIZE - length);
+	std::copy_n((const uint8_t *)header, DST_HEADER_SIZE, buffer.begin());
+
+	return buffer;
+}
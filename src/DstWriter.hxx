@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "StitchWriter.hxx"
+#include "PesPoint.hxx"
+#include "PesBounds.hxx"
+
+/**
+ * Writes a Tajima DST file.  Each command is a 3 byte record with
+ * the coordinates in balanced ternary; the y axis points up.  The
+ * header is filled in by Finish().
+ */
+class DstWriter final : public StitchWriter<DstWriter> {
+	static constexpr uint8_t FLAG_JUMP = 0x80;
+
+	char label[17];
+
+	/**
+	 * The needle position relative to the start.
+	 */
+	PesPoint position{0, 0};
+
+	PesBounds bounds;
+
+	unsigned n_color_changes = 0;
+
+public:
+	static constexpr int MIN_DELTA = -121, MAX_DELTA = 121;
+
+	/**
+	 * @param label the design name for the header; only the
+	 * first 16 characters are used
+	 */
+	explicit DstWriter(const char *label);
+
+	void Stitch(int x, int y) {
+		Record(x, y, 0);
+	}
+
+	void JumpStitch(int x, int y) {
+		Record(x, y, FLAG_JUMP);
+	}
+
+	void TrimStitch(int x, int y) {
+		/* DST has no trim command; machines cut the thread
+		   after a sequence of jumps which returns to the same
+		   place */
+		JumpStitch(2, 2);
+		JumpStitch(-4, -4);
+		JumpStitch(2, 2);
+		JumpStitch(x, y);
+	}
+
+	void ColorChange(unsigned index) {
+		/* the first color needs no command */
+		if (index > 0) {
+			Command(0xc3);
+			++n_color_changes;
+		}
+	}
+
+	void End() {
+		Command(0xf3);
+	}
+
+	/**
+	 * Write the end mark and fill in the header.
+	 */
+	ConstBuffer<uint8_t> Finish();
+
+private:
+	void Record(int x, int y, uint8_t flags);
+	void Command(uint8_t b2);
+};
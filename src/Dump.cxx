@@ -16,122 +16,565 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
-#include "PesFormat.hxx"
+
+#include "PesReader.hxx"
+#include "PesSummary.hxx"
+#include "PesRender.hxx"
 #include "util/SystemError.hxx"
 #include "util/ScopeExit.hxx"
 
+#include <algorithm>
+#include <atomic>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+enum class OutputFormat {
+	TEXT,
+	CSV,
+	JSON,
+};
+
+/**
+ * The result of analyzing one file.
+ */
+struct FileResult {
+	std::string path;
+	PesSummary summary;
+
+	/**
+	 * Non-empty if the file could not be analyzed.
+	 */
+	std::string error;
+
+	explicit FileResult(std::string &&_path):path(std::move(_path)) {}
+};
+
+static const char *
+GetStitchName(PesStitch::Type type)
+{
+	switch (type) {
+	case PesStitch::Type::STITCH:
+		return "stitch";
+
+	case PesStitch::Type::JUMP:
+		return "jump";
+
+	case PesStitch::Type::TRIM:
+		return "trim";
+
+	case PesStitch::Type::COLOR_CHANGE:
+		break;
+	}
+
+	return "color";
+}
+
+/**
+ * Print every command of one file.
+ */
+static void
+DumpFile(const char *path)
+{
+	const PesFile file(path);
+	const PesReader &reader = file.GetReader();
+
+	std::vector<PesStitch> stitches;
+	reader.Decode(stitches);
+
+	printf("width = %u\n"
+	       "height = %u\n",
+	       reader.GetWidth(), reader.GetHeight());
+
+	const auto colors = reader.GetColors();
+	for (unsigned i = 0; i < colors.size; ++i)
+		printf("color[%u] = %u\n", i, colors[i]);
+
+	PesPoint position(0, 0);
+	for (const auto &i : stitches) {
+		if (i.type == PesStitch::Type::COLOR_CHANGE) {
+			printf("color %u\n", i.color);
+			continue;
+		}
+
+		const PesPoint delta = i.position - position;
+		position = i.position;
+
+		printf("%s %d %d\n", GetStitchName(i.type), delta.x, delta.y);
+	}
+}
+
+/**
+ * Render a preview of one file.
+ */
+static void
+RenderFile(const char *path, const char *ppm_path,
+	   unsigned size, unsigned n_threads)
+{
+	const PesFile file(path);
+
+	std::vector<PesStitch> stitches;
+	file.GetReader().Decode(stitches);
+
+	RenderPes(file.GetReader(), stitches, size, n_threads)
+		.WritePpm(ppm_path);
+}
+
+gcc_pure
+static bool
+IsPesFile(const char *name)
+{
+	const size_t length = strlen(name);
+	return length > 4 && strcasecmp(name + length - 4, ".pes") == 0;
+}
+
+/**
+ * Collect all PES files in the given directory and its
+ * subdirectories.
+ */
+static void
+ScanDirectory(std::vector<std::string> &dest, const std::string &path)
+{
+	DIR *dir = opendir(path.c_str());
+	if (dir == nullptr)
+		throw FormatErrno("Failed to open %s", path.c_str());
+
+	AtScopeExit(dir) { closedir(dir); };
+
+	const struct dirent *ent;
+	while ((ent = readdir(dir)) != nullptr) {
+		const char *name = ent->d_name;
+		if (*name == '.')
+			continue;
+
+		std::string child = path + "/" + name;
+
+		bool is_dir = ent->d_type == DT_DIR;
+		bool is_file = ent->d_type == DT_REG;
+		if (ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK) {
+			struct stat st;
+			if (stat(child.c_str(), &st) < 0)
+				continue;
+
+			is_dir = S_ISDIR(st.st_mode);
+			is_file = S_ISREG(st.st_mode);
+		}
+
+		if (is_dir)
+			ScanDirectory(dest, child);
+		else if (is_file && IsPesFile(name))
+			dest.emplace_back(std::move(child));
+	}
+}
+
+/**
+ * Analyze all files with the given number of threads, each with its
+ * own #PesAnalyzer.
+ */
+static void
+AnalyzeFiles(std::vector<FileResult> &results, const PesAnalyzer &prototype,
+	     unsigned n_threads)
+{
+	std::atomic<size_t> next(0);
+
+	auto worker = [&results, &prototype, &next](){
+		PesAnalyzer analyzer;
+		analyzer.cost = prototype.cost;
+		analyzer.hotspot_threshold = prototype.hotspot_threshold;
+
+		size_t i;
+		while ((i = next.fetch_add(1, std::memory_order_relaxed)) < results.size()) {
+			auto &result = results[i];
+			try {
+				const PesFile file(result.path.c_str());
+				result.summary = analyzer.Analyze(file.GetReader());
+			} catch (const std::exception &e) {
+				result.error = e.what();
+			}
+		}
+	};
+
+	n_threads = std::max(std::min<size_t>(n_threads, results.size()),
+			     size_t(1));
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < n_threads; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto &i : threads)
+		i.join();
+}
+
+static constexpr double
+ToMillimeters(double pes)
+{
+	return pes / 10;
+}
 
 static void
-FullRead(FILE *file, void *buffer, size_t size)
+PrintText(const FileResult &result)
 {
-	if (fread(buffer, size, 1, file) != 1)
-		throw std::runtime_error("Short read");
+	printf("file = %s\n", result.path.c_str());
+	if (!result.error.empty()) {
+		printf("error = %s\n\n", result.error.c_str());
+		return;
+	}
+
+	const auto &s = result.summary;
+	printf("width = %.1f mm\n"
+	       "height = %.1f mm\n"
+	       "stitches = %lu\n"
+	       "jumps = %lu\n"
+	       "trims = %lu\n"
+	       "color_changes = %u\n"
+	       "thread_length = %.1f mm\n",
+	       ToMillimeters(s.width), ToMillimeters(s.height),
+	       s.stitches, s.jumps, s.trims, s.color_changes,
+	       ToMillimeters(s.thread_length));
+
+	for (const auto &c : s.colors)
+		printf("thread_length[%u] = %.1f mm (%lu stitches)\n",
+		       c.color, ToMillimeters(c.thread_length), c.stitches);
+
+	if (!s.bounds.IsEmpty())
+		printf("bounds = %.1f %.1f %.1f %.1f mm\n",
+		       ToMillimeters(s.bounds.min_x),
+		       ToMillimeters(s.bounds.min_y),
+		       ToMillimeters(s.bounds.max_x),
+		       ToMillimeters(s.bounds.max_y));
+
+	printf("longest_stitch = %.1f mm\n"
+	       "max_density = %u per mm² at %.0f %.0f mm\n"
+	       "hotspots = %lu\n"
+	       "seconds = %.0f\n\n",
+	       ToMillimeters(s.longest_stitch),
+	       s.max_density,
+	       ToMillimeters(s.max_density_position.x),
+	       ToMillimeters(s.max_density_position.y),
+	       s.hotspots, s.seconds);
+}
+
+static void
+PrintCsvString(const std::string &s)
+{
+	if (s.find_first_of(",\"\n") == s.npos) {
+		fputs(s.c_str(), stdout);
+		return;
+	}
+
+	putchar('"');
+	for (char ch : s) {
+		if (ch == '"')
+			putchar('"');
+		putchar(ch);
+	}
+	putchar('"');
+}
+
+static void
+PrintCsvHeader()
+{
+	puts("file,width_mm,height_mm,stitches,jumps,trims,color_changes,"
+	     "thread_length_mm,thread_length_by_color_mm,"
+	     "min_x_mm,min_y_mm,max_x_mm,max_y_mm,"
+	     "longest_stitch_mm,max_density,hotspots,seconds,error");
 }
 
-static uint8_t
-ReadByte(FILE *file)
+static void
+PrintCsv(const FileResult &result)
 {
-	int ch = fgetc(file);
-	if (ch == EOF)
-		throw std::runtime_error("Premature end of file");
+	PrintCsvString(result.path);
+
+	if (!result.error.empty()) {
+		fputs(",,,,,,,,,,,,,,,,,", stdout);
+		PrintCsvString(result.error);
+		putchar('\n');
+		return;
+	}
+
+	const auto &s = result.summary;
+	printf(",%.1f,%.1f,%lu,%lu,%lu,%u,%.1f,",
+	       ToMillimeters(s.width), ToMillimeters(s.height),
+	       s.stitches, s.jumps, s.trims, s.color_changes,
+	       ToMillimeters(s.thread_length));
+
+	/* "COLOR:LENGTH" pairs separated by semicolons */
+	bool first = true;
+	for (const auto &c : s.colors) {
+		printf(first ? "%u:%.1f" : ";%u:%.1f",
+		       c.color, ToMillimeters(c.thread_length));
+		first = false;
+	}
+
+	if (s.bounds.IsEmpty())
+		fputs(",,,,", stdout);
+	else
+		printf(",%.1f,%.1f,%.1f,%.1f",
+		       ToMillimeters(s.bounds.min_x),
+		       ToMillimeters(s.bounds.min_y),
+		       ToMillimeters(s.bounds.max_x),
+		       ToMillimeters(s.bounds.max_y));
+
+	printf(",%.1f,%u,%lu,%.0f,\n",
+	       ToMillimeters(s.longest_stitch), s.max_density,
+	       s.hotspots, s.seconds);
+}
 
-	return ch;
+static void
+PrintJsonString(const std::string &s)
+{
+	putchar('"');
+	for (char ch : s) {
+		if (ch == '"' || ch == '\\')
+			printf("\\%c", ch);
+		else if ((unsigned char)ch < 0x20)
+			printf("\\u%04x", ch);
+		else
+			putchar(ch);
+	}
+	putchar('"');
 }
 
 static void
-Seek(FILE *file, long offset, int whence)
+PrintJson(const FileResult &result)
 {
-	if (fseek(file, offset, whence) != 0)
-		throw MakeErrno("Seek failed");
+	fputs("{\"file\":", stdout);
+	PrintJsonString(result.path);
+
+	if (!result.error.empty()) {
+		fputs(",\"error\":", stdout);
+		PrintJsonString(result.error);
+		putchar('}');
+		return;
+	}
+
+	const auto &s = result.summary;
+	printf(",\"width_mm\":%.1f,\"height_mm\":%.1f"
+	       ",\"stitches\":%lu,\"jumps\":%lu,\"trims\":%lu"
+	       ",\"color_changes\":%u,\"thread_length_mm\":%.1f"
+	       ",\"colors\":[",
+	       ToMillimeters(s.width), ToMillimeters(s.height),
+	       s.stitches, s.jumps, s.trims, s.color_changes,
+	       ToMillimeters(s.thread_length));
+
+	bool first = true;
+	for (const auto &c : s.colors) {
+		printf("%s{\"color\":%u,\"stitches\":%lu,\"thread_length_mm\":%.1f}",
+		       first ? "" : ",", c.color, c.stitches,
+		       ToMillimeters(c.thread_length));
+		first = false;
+	}
+
+	putchar(']');
+
+	if (!s.bounds.IsEmpty())
+		printf(",\"bounds_mm\":[%.1f,%.1f,%.1f,%.1f]",
+		       ToMillimeters(s.bounds.min_x),
+		       ToMillimeters(s.bounds.min_y),
+		       ToMillimeters(s.bounds.max_x),
+		       ToMillimeters(s.bounds.max_y));
+
+	printf(",\"longest_stitch_mm\":%.1f,\"max_density\":%u"
+	       ",\"max_density_position_mm\":[%.0f,%.0f]"
+	       ",\"hotspots\":%lu,\"seconds\":%.0f}",
+	       ToMillimeters(s.longest_stitch), s.max_density,
+	       ToMillimeters(s.max_density_position.x),
+	       ToMillimeters(s.max_density_position.y),
+	       s.hotspots, s.seconds);
 }
 
 static void
-CheckHeader(const PesHeader &header)
+Usage(const char *argv0)
 {
-	const PesHeader expected{};
+	fprintf(stderr, "Usage: %s INFILE.pes\n"
+		"       %s --render=OUTFILE.ppm [--size=PIXELS] INFILE.pes\n"
+		"       %s --summary [OPTIONS] FILE|DIRECTORY...\n"
+		"\n"
+		"Options:\n"
+		"  --summary          print statistics instead of all stitches;\n"
+		"                     implied by several files or a directory\n"
+		"  --format=FORMAT    text (default), csv or json\n"
+		"  --jobs=N           number of threads (default: all CPUs)\n"
+		"  --hotspot=N        needle points per mm² above which a cell is\n"
+		"                     a hotspot (default 10)\n"
+		"  --speed=SPM        machine speed in stitches per minute (default 600)\n"
+		"  --render=FILE      draw the stitches to a PPM file\n"
+		"  --size=PIXELS      the size of the longer side of the image\n"
+		"                     (default 1000)\n",
+		argv0, argv0, argv0);
+}
 
-	if (memcmp(header.id, expected.id, sizeof(expected.id)) != 0)
-		throw std::runtime_error("Malformed PES id");
+static unsigned
+ParsePositive(const char *s)
+{
+	char *endptr;
+	const unsigned long value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0 || value == 0)
+		throw std::runtime_error("Malformed number");
+	return value;
 }
 
 int
 main(int argc, char **argv)
 try {
-	if (argc != 2) {
-		fprintf(stderr, "Usage: %s INFILE.pes\n", argv[0]);
+	enum {
+		OPTION_SUMMARY = 0x100,
+		OPTION_FORMAT,
+		OPTION_JOBS,
+		OPTION_HOTSPOT,
+		OPTION_SPEED,
+		OPTION_RENDER,
+		OPTION_SIZE,
+	};
+
+	static const struct option long_options[] = {
+		{"summary", no_argument, nullptr, OPTION_SUMMARY},
+		{"format", required_argument, nullptr, OPTION_FORMAT},
+		{"jobs", required_argument, nullptr, OPTION_JOBS},
+		{"hotspot", required_argument, nullptr, OPTION_HOTSPOT},
+		{"speed", required_argument, nullptr, OPTION_SPEED},
+		{"render", required_argument, nullptr, OPTION_RENDER},
+		{"size", required_argument, nullptr, OPTION_SIZE},
+		{nullptr, 0, nullptr, 0}
+	};
+
+	bool summary = false;
+	OutputFormat format = OutputFormat::TEXT;
+	unsigned n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	PesAnalyzer prototype;
+	const char *render_path = nullptr;
+	unsigned render_size = 1000;
+
+	int o;
+	while ((o = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+		switch (o) {
+		case OPTION_SUMMARY:
+			summary = true;
+			break;
+
+		case OPTION_FORMAT:
+			summary = true;
+			if (strcmp(optarg, "text") == 0)
+				format = OutputFormat::TEXT;
+			else if (strcmp(optarg, "csv") == 0)
+				format = OutputFormat::CSV;
+			else if (strcmp(optarg, "json") == 0)
+				format = OutputFormat::JSON;
+			else
+				throw std::runtime_error("Unknown format");
+			break;
+
+		case OPTION_JOBS:
+			n_threads = ParsePositive(optarg);
+			break;
+
+		case OPTION_HOTSPOT:
+			prototype.hotspot_threshold = ParsePositive(optarg);
+			break;
+
+		case OPTION_SPEED:
+			prototype.cost.stitches_per_minute = ParsePositive(optarg);
+			break;
+
+		case OPTION_RENDER:
+			render_path = optarg;
+			break;
+
+		case OPTION_SIZE:
+			render_size = ParsePositive(optarg);
+			break;
+
+		default:
+			Usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind == argc) {
+		Usage(argv[0]);
 		return EXIT_FAILURE;
 	}
 
-	const auto in_path = argv[1];
+	if (render_path != nullptr) {
+		if (summary || argc - optind != 1) {
+			Usage(argv[0]);
+			return EXIT_FAILURE;
+		}
 
-	FILE *file = fopen(in_path, "rb");
-	if (file == nullptr) {
-		fprintf(stderr, "Failed to open %s: %s\n",
-			in_path, strerror(errno));
-		return EXIT_FAILURE;
+		RenderFile(argv[optind], render_path, render_size, n_threads);
+		return EXIT_SUCCESS;
 	}
 
-	AtScopeExit(file) { fclose(file); };
+	static char buffer[65536];
+	setvbuf(stdout, buffer, _IOFBF, sizeof(buffer));
 
-	PesHeader pes_header;
-	FullRead(file, &pes_header, sizeof(pes_header));
-	CheckHeader(pes_header);
+	std::vector<std::string> paths;
+	for (int i = optind; i < argc; ++i) {
+		struct stat st;
+		if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+			summary = true;
+			const size_t start = paths.size();
+			ScanDirectory(paths, argv[i]);
+			std::sort(std::next(paths.begin(), start), paths.end());
+		} else
+			paths.emplace_back(argv[i]);
+	}
 
-	Seek(file, FromLE32(pes_header.pec_offset), SEEK_SET);
+	if (paths.size() > 1)
+		summary = true;
 
-	PecHeader pec_header(0, 0);
-	FullRead(file, &pec_header, sizeof(pec_header));
+	if (!summary) {
+		DumpFile(paths.front().c_str());
+		return EXIT_SUCCESS;
+	}
 
-	printf("width = %u\n"
-	       "height = %u\n",
-	       FromLE16(pec_header.width),
-	       FromLE16(pec_header.height));
-
-	for (unsigned i = 0, n = pec_header.n_colors; i < n; ++i)
-		printf("color[%u] = %u\n", i, pec_header.colors[i]);
-
-	while (true) {
-		uint8_t b = ReadByte(file);
-		if ((b & 0x80) == 0) {
-			int delta = b;
-			if (delta & 0x40)
-				delta -= 0x80;
-
-			printf("smallstitch %d\n", delta);
-		} else if (b == 0xfe) {
-			b = ReadByte(file);
-			if (b == 0xb0)
-				printf("color %u\n", ReadByte(file));
-			else
-				throw std::runtime_error("Unknown 0xfe command");
-		} else if (b == 0xff) {
-			b = ReadByte(file);
-			if (b == 0x00)
-				break;
-
-			throw std::runtime_error("Unknown 0xff command");
-		} else if ((b & 0xc0) == 0x80) {
-			unsigned flags = b & 0x30;
-			int delta = ((b & 0xf) << 8) | ReadByte(file);
-			if (delta & 0x800)
-				delta -= 0x1000;
-
-			const char *operation = "bigstitch";
-			if (flags & 0x20)
-				operation = "trim";
-			else if (flags & 0x10)
-				operation = "jump";
-
-			printf("%s %d\n", operation, delta);
-		} else
-			throw std::runtime_error("Unknown sequence");
+	std::vector<FileResult> results;
+	results.reserve(paths.size());
+	for (auto &i : paths)
+		results.emplace_back(std::move(i));
+
+	AnalyzeFiles(results, prototype, n_threads);
+
+	bool failed = false;
+	switch (format) {
+	case OutputFormat::TEXT:
+		for (const auto &i : results)
+			PrintText(i);
+		break;
+
+	case OutputFormat::CSV:
+		PrintCsvHeader();
+		for (const auto &i : results)
+			PrintCsv(i);
+		break;
+
+	case OutputFormat::JSON:
+		putchar('[');
+		for (size_t i = 0; i < results.size(); ++i) {
+			if (i > 0)
+				fputs(",\n", stdout);
+			PrintJson(results[i]);
+		}
+		puts("]");
+		break;
 	}
 
-	return EXIT_SUCCESS;
+	for (const auto &i : results)
+		if (!i.error.empty())
+			failed = true;
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 } catch (const std::exception &e) {
 	fprintf(stderr, "Error: %s\n", e.what());
 	return EXIT_FAILURE;
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "StitchWriter.hxx"
+
+/**
+ * Encode a Melco EXP or Janome JEF coordinate pair; the y axis
+ * points up.
+ */
+static inline uint8_t *
+ExpStitch(uint8_t *p, int x, int y)
+{
+	*p++ = x & 0xff;
+	*p++ = -y & 0xff;
+	return p;
+}
+
+/**
+ * A control command (0x80 COMMAND X Y).
+ */
+static inline uint8_t *
+ExpCommand(uint8_t *p, uint8_t command, int x, int y)
+{
+	*p++ = 0x80;
+	*p++ = command;
+	return ExpStitch(p, x, y);
+}
+
+/**
+ * Writes a Melco EXP file, which has no header: each stitch is a
+ * pair of signed bytes, and 0x80 introduces a command.
+ */
+class ExpWriter final : public StitchWriter<ExpWriter> {
+public:
+	/* -128 would be confused with a command */
+	static constexpr int MIN_DELTA = -127, MAX_DELTA = 127;
+
+	void Stitch(int x, int y) {
+		GenerateWrite(ExpStitch, x, y);
+	}
+
+	void JumpStitch(int x, int y) {
+		GenerateWrite(ExpCommand, uint8_t(0x04), x, y);
+	}
+
+	void TrimStitch(int x, int y) {
+		/* 0x80 0x80 0x07 0x00 */
+		GenerateWrite(ExpCommand, uint8_t(0x80), 7, 0);
+		JumpStitch(x, y);
+	}
+
+	void ColorChange(unsigned index) {
+		/* the first color needs no command */
+		if (index > 0)
+			GenerateWrite(ExpCommand, uint8_t(0x01), 0, 0);
+	}
+
+	void End() {
+		/* the file just ends */
+	}
+
+	ConstBuffer<uint8_t> Finish() {
+		End();
+		return buffer;
+	}
+};
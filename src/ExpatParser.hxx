@@ -19,6 +19,8 @@
 #ifndef MPD_EXPAT_HXX
 #define MPD_EXPAT_HXX
 
+#include "XmlTokenizer.hxx"
+#include "MemoryStats.hxx"
 #include "Compiler.h"
 
 #include <expat.h>
@@ -39,7 +41,7 @@ class ExpatParser final {
 
 public:
 	ExpatParser(void *userData)
-		:parser(XML_ParserCreate(nullptr)) {
+		:parser(Create()) {
 		XML_SetUserData(parser, userData);
 	}
 
@@ -59,6 +61,23 @@ public:
 		XML_SetCharacterDataHandler(parser, charhndl);
 	}
 
+	/**
+	 * Limit the ratio of output (after entity expansion) to input
+	 * bytes.  Unlike Expat's default, this is enforced as soon as
+	 * entities have produced 64 kB.
+	 *
+	 * @return false if this Expat version cannot do that
+	 */
+	bool SetMaxAmplification(float factor) {
+#ifdef HAVE_EXPAT_AMPLIFICATION
+		return XML_SetBillionLaughsAttackProtectionMaximumAmplification(parser, factor) &&
+			XML_SetBillionLaughsAttackProtectionActivationThreshold(parser, 65536);
+#else
+		(void)factor;
+		return false;
+#endif
+	}
+
 	void Parse(const char *data, size_t length, bool is_final);
 
 	gcc_pure
@@ -68,25 +87,82 @@ public:
 	gcc_pure
 	static const char *GetAttributeCase(const XML_Char **atts,
 					    const char *name);
+
+private:
+	static XML_Parser Create() {
+#ifdef ENABLE_MEMORY_STATS
+		static constexpr XML_Memory_Handling_Suite memory_suite = {
+			XmlMalloc, XmlRealloc, XmlFree,
+		};
+		return XML_ParserCreate_MM(nullptr, &memory_suite, nullptr);
+#else
+		return XML_ParserCreate(nullptr);
+#endif
+	}
 };
 
 /**
  * A specialization of #ExpatParser that provides the most common
- * callbacks as virtual methods.
+ * callbacks as virtual methods.  Alternatively, the same callbacks can
+ * be driven by the built-in in-situ tokenizer (see ParseInSitu()).
  */
-class CommonExpatParser {
+class CommonExpatParser : XmlTokenizerHandler {
 	ExpatParser parser;
 
+	/**
+	 * Deliver character data to CharacterData()?
+	 */
+	bool character_data;
+
+	/**
+	 * Is ParseInSitu() running (instead of Expat)?
+	 */
+	bool in_situ = false;
+
+	/**
+	 * The number of open elements while skipping a subtree; 0 if
+	 * not skipping.
+	 */
+	unsigned skip_depth = 0;
+
 public:
-	CommonExpatParser():parser(this) {
+	/**
+	 * @param _character_data deliver character data to
+	 * CharacterData()?
+	 */
+	explicit CommonExpatParser(bool _character_data=true)
+		:parser(this), character_data(_character_data) {
 		parser.SetElementHandler(StartElement, EndElement);
-		parser.SetCharacterDataHandler(CharacterData);
+		if (character_data)
+			parser.SetCharacterDataHandler(CharacterData);
 	}
 
 	void Parse(const char *data, size_t length, bool is_final) {
 		parser.Parse(data, length, is_final);
 	}
 
+	/**
+	 * @see ExpatParser::SetMaxAmplification()
+	 */
+	bool SetMaxAmplification(float factor) {
+		return parser.SetMaxAmplification(factor);
+	}
+
+	/**
+	 * Parse a complete document with TokenizeXmlInSitu() instead
+	 * of Expat.  The buffer is modified.  Throws
+	 * #XmlTokenizerError if the tokenizer rejects the document;
+	 * since callbacks may have been invoked already, the caller
+	 * must then start over with a new object and Parse().
+	 *
+	 * Like with Expat, only the character data enabled by
+	 * #character_data (see SetCharacterDataEnabled()) is decoded.
+	 */
+	void ParseInSitu(char *data, size_t length) {
+		in_situ = true;
+		TokenizeXmlInSitu(data, length, *this);
+	}
+
 	gcc_pure
 	static const char *GetAttribute(const XML_Char **atts,
 					const char *name) {
@@ -100,10 +176,46 @@ public:
 	}
 
 protected:
+	/**
+	 * Ignore the element currently being handled by
+	 * StartElement(), including all of its children and their
+	 * character data.  Until its end tag, Expat runs with minimal
+	 * handlers; EndElement() will not be called for it.
+	 */
+	void SkipElement() {
+		skip_depth = 1;
+		if (in_situ)
+			return;
+
+		parser.SetElementHandler(SkipStartElement, SkipEndElement);
+		if (character_data)
+			parser.SetCharacterDataHandler(nullptr);
+	}
+
+	/**
+	 * Start or stop delivering character data to CharacterData().
+	 * Disabling it when it is not needed saves the callback
+	 * overhead for every text node.
+	 */
+	void SetCharacterDataEnabled(bool enabled) {
+		character_data = enabled;
+		if (in_situ || skip_depth > 0)
+			return;
+
+		if (enabled)
+			parser.SetCharacterDataHandler(CharacterData);
+		else
+			parser.SetCharacterDataHandler(nullptr);
+	}
+
 	virtual void StartElement(const XML_Char *name,
 				  const XML_Char **atts) = 0;
 	virtual void EndElement(const XML_Char *name) = 0;
-	virtual void CharacterData(const XML_Char *s, int len) = 0;
+
+	virtual void CharacterData(const XML_Char *s, int len) {
+		(void)s;
+		(void)len;
+	}
 
 private:
 	static void XMLCALL StartElement(void *user_data, const XML_Char *name,
@@ -122,6 +234,53 @@ private:
 		CommonExpatParser &p = *(CommonExpatParser *)user_data;
 		p.CharacterData(s, len);
 	}
+
+	static void XMLCALL SkipStartElement(void *user_data,
+					     const XML_Char *,
+					     const XML_Char **) {
+		CommonExpatParser &p = *(CommonExpatParser *)user_data;
+		++p.skip_depth;
+	}
+
+	static void XMLCALL SkipEndElement(void *user_data, const XML_Char *) {
+		CommonExpatParser &p = *(CommonExpatParser *)user_data;
+		if (--p.skip_depth > 0)
+			return;
+
+		p.parser.SetElementHandler(StartElement, EndElement);
+		if (p.character_data)
+			p.parser.SetCharacterDataHandler(CharacterData);
+	}
+
+	/* virtual methods from class XmlTokenizerHandler */
+	void OnXmlStartElement(const char *name,
+			       const char **atts) override {
+		if (skip_depth > 0)
+			++skip_depth;
+		else
+			StartElement(name, atts);
+	}
+
+	void OnXmlEndElement(const char *name) override {
+		if (skip_depth > 0)
+			--skip_depth;
+		else
+			EndElement(name);
+	}
+
+	bool WantXmlCharacterData() const noexcept override {
+		return character_data && skip_depth == 0;
+	}
+
+	void OnXmlCharacterData(const char *s, size_t length) override {
+		while (length > 0) {
+			const int chunk = length > 0x40000000
+				? 0x40000000 : int(length);
+			CharacterData(s, chunk);
+			s += chunk;
+			length -= chunk;
+		}
+	}
 };
 
 #endif
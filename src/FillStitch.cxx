@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "FillStitch.hxx"
+#include "SvgData.hxx"
+#include "ResourceBudget.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+namespace {
+
+/**
+ * A non-horizontal edge of the outline.
+ */
+struct Edge {
+	double y_min, y_max;
+
+	/**
+	 * The x coordinate at #y_min.
+	 */
+	double x;
+
+	/**
+	 * The change of x per y.
+	 */
+	double slope;
+
+	/**
+	 * +1 if the edge points downwards, -1 if it points upwards.
+	 */
+	int winding;
+
+	constexpr double XAt(double y) const noexcept {
+		return x + (y - y_min) * slope;
+	}
+};
+
+struct ActiveEdge {
+	const Edge *edge;
+
+	/**
+	 * The intersection with the current scanline.
+	 */
+	double x;
+};
+
+/**
+ * A horizontal section of a row which is inside the shape.
+ */
+struct Span {
+	double x0, x1;
+
+	constexpr bool Overlaps(Span other) const noexcept {
+		return x0 < other.x1 && other.x0 < x1;
+	}
+};
+
+void
+AddEdge(std::vector<Edge> &edges, SvgPoint a, SvgPoint b)
+{
+	int winding = 1;
+	if (a.y > b.y) {
+		std::swap(a, b);
+		winding = -1;
+	} else if (!(a.y < b.y))
+		/* horizontal edges never intersect a scanline */
+		return;
+
+	edges.push_back({a.y, b.y, a.x, (b.x - a.x) / (b.y - a.y), winding});
+}
+
+/**
+ * Collect all edges of all subpaths, sorted by their top end.
+ */
+void
+BuildEdgeTable(std::vector<Edge> &edges, const SvgPath &path)
+{
+	const auto &points = path.points;
+	edges.reserve(points.size());
+
+	for (size_t end = 0; end < points.size();) {
+		const size_t start = end++;
+		while (end < points.size() &&
+		       !points[end].IsMove())
+			++end;
+
+		for (size_t i = start + 1; i < end; ++i)
+			AddEdge(edges, points[i - 1].GetPoint(),
+				points[i].GetPoint());
+
+		/* close the subpath */
+		AddEdge(edges, points[end - 1].GetPoint(),
+			points[start].GetPoint());
+	}
+
+	std::sort(edges.begin(), edges.end(),
+		  [](const Edge &a, const Edge &b){
+			  return a.y_min < b.y_min;
+		  });
+}
+
+/**
+ * Determine the spans of the current scanline from the active edge
+ * list, which must be sorted by x.
+ */
+void
+CollectSpans(std::vector<Span> &spans,
+	     const std::vector<ActiveEdge> &active, SvgFillRule rule)
+{
+	spans.clear();
+
+	int winding = 0;
+	double start = 0;
+	for (const auto &i : active) {
+		const bool was_inside = winding != 0;
+
+		if (rule == SvgFillRule::EVENODD)
+			winding ^= 1;
+		else
+			winding += i.edge->winding;
+
+		const bool inside = winding != 0;
+		if (inside && !was_inside)
+			start = i.x;
+		else if (!inside && was_inside && i.x > start)
+			spans.push_back({start, i.x});
+	}
+}
+
+/**
+ * Append a straight line, split into stitches not longer than
+ * #length.  The start point is expected to be already in the run.
+ */
+void
+AppendLine(std::vector<SvgPoint> &run, SvgPoint to, double length)
+{
+	const SvgPoint from = run.back();
+	const SvgPoint delta = to - from;
+	const unsigned n = unsigned(ceil(sqrt(delta.SquareMagnitude()) / length));
+	for (unsigned i = 1; i < n; ++i)
+		run.push_back(from + delta * (double(i) / n));
+	run.push_back(to);
+}
+
+/**
+ * Append the stitches of one row.  Needle points are placed on a
+ * grid shifted by #phase, which produces the brick pattern; points
+ * too close to the row ends are omitted.  The start point is
+ * expected to be already in the run.
+ */
+void
+AppendRow(std::vector<SvgPoint> &run, double y, double from, double to,
+	  double phase, const FillStitchOptions &options)
+{
+	const double length = options.length;
+	const double min_length = options.min_length;
+
+	if (from < to) {
+		for (long k = long(ceil((from + min_length - phase) / length));; ++k) {
+			const double x = phase + k * length;
+			if (x > to - min_length)
+				break;
+			run.emplace_back(x, y);
+		}
+	} else {
+		for (long k = long(floor((from - min_length - phase) / length));; --k) {
+			const double x = phase + k * length;
+			if (x < to + min_length)
+				break;
+			run.emplace_back(x, y);
+		}
+	}
+
+	run.emplace_back(to, y);
+}
+
+/**
+ * A run which may be continued in the next row.  The list of open
+ * runs is sorted by x.
+ */
+struct OpenRun {
+	size_t index;
+
+	/**
+	 * The span sewn in the previous row.
+	 */
+	Span span;
+
+	/**
+	 * The direction of the previous row.
+	 */
+	bool left_to_right;
+
+	bool extended;
+};
+
+}
+
+void
+FillStitch(std::vector<std::vector<SvgPoint>> &dest, const SvgPath &path,
+	   const FillStitchOptions &options)
+{
+	assert(options.spacing > 0);
+	assert(options.length > 0);
+	assert(options.stagger > 0);
+
+	std::vector<Edge> edges;
+	BuildEdgeTable(edges, path);
+	if (edges.empty())
+		return;
+
+	double top = edges.front().y_min, bottom = top;
+	for (const auto &i : edges)
+		bottom = std::max(bottom, i.y_max);
+
+	/* center the rows vertically; shapes thinner than the
+	   spacing get one row in the middle */
+	const double spacing = options.spacing;
+	const double height = bottom - top;
+	const double n_rows = std::max(floor(height / spacing), 1.);
+	const double first_y = top + (height - (n_rows - 1) * spacing) / 2;
+
+	std::vector<ActiveEdge> active;
+	std::vector<Span> spans;
+	std::vector<OpenRun> open, next_open;
+
+	size_t next_edge = 0;
+	for (unsigned long row = 0; row < n_rows; ++row) {
+		const double y = first_y + row * spacing;
+
+		/* update the active edge list */
+		while (next_edge < edges.size() && edges[next_edge].y_min <= y)
+			active.push_back({&edges[next_edge++], 0});
+
+		active.erase(std::remove_if(active.begin(), active.end(),
+					    [y](const ActiveEdge &e){
+						    return e.edge->y_max <= y;
+					    }),
+			     active.end());
+
+		if (active.empty()) {
+			open.clear();
+
+			if (next_edge == edges.size())
+				break;
+
+			/* skip empty rows quickly */
+			const double next_row =
+				ceil((edges[next_edge].y_min - first_y) / spacing);
+			row = std::max(row, (unsigned long)next_row - 1);
+			continue;
+		}
+
+		for (auto &i : active)
+			i.x = i.edge->XAt(y);
+
+		/* the list is almost sorted from the previous row, so
+		   insertion sort is cheap */
+		for (size_t i = 1; i < active.size(); ++i) {
+			const ActiveEdge e = active[i];
+			size_t j = i;
+			for (; j > 0 && active[j - 1].x > e.x; --j)
+				active[j] = active[j - 1];
+			active[j] = e;
+		}
+
+		CollectSpans(spans, active, path.fill_rule);
+
+		const double phase = (row % options.stagger) * options.length
+			/ options.stagger;
+
+		/* both "open" (from the previous row) and "spans" are
+		   sorted by x and disjoint, so the runs which may be
+		   continued are found with one forward scan; runs which
+		   are not continued in this row are finished */
+		next_open.clear();
+		size_t first_open = 0;
+
+		for (const auto &span : spans) {
+			if (span.x1 - span.x0 < options.min_length)
+				continue;
+
+			/* account the row before generating it, which
+			   may be huge */
+			if (options.budget != nullptr)
+				options.budget->AddStitches(size_t((span.x1 - span.x0) /
+								   options.length) + 2);
+
+			while (first_open < open.size() &&
+			       open[first_open].span.x1 <= span.x0)
+				++first_open;
+
+			OpenRun *o = nullptr;
+			for (size_t i = first_open;
+			     i < open.size() && open[i].span.Overlaps(span);
+			     ++i) {
+				if (!open[i].extended) {
+					o = &open[i];
+					break;
+				}
+			}
+
+			bool left_to_right;
+			size_t index;
+			if (o != nullptr) {
+				o->extended = true;
+				left_to_right = !o->left_to_right;
+				index = o->index;
+				AppendLine(dest[index],
+					   SvgPoint(left_to_right ? span.x0 : span.x1, y),
+					   options.length);
+			} else {
+				left_to_right = true;
+				index = dest.size();
+				dest.emplace_back();
+				dest.back().emplace_back(span.x0, y);
+			}
+
+			next_open.push_back({index, span, left_to_right, false});
+
+			AppendRow(dest[index], y,
+				  left_to_right ? span.x0 : span.x1,
+				  left_to_right ? span.x1 : span.x0,
+				  phase, options);
+		}
+
+		open.swap(next_open);
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <vector>
+
+struct SvgPoint;
+struct SvgPath;
+class ResourceBudget;
+
+struct FillStitchOptions {
+	/**
+	 * The distance between two rows.
+	 */
+	double spacing;
+
+	/**
+	 * The target length of stitches within a row.
+	 */
+	double length;
+
+	/**
+	 * Needle points closer than this to the end of a row are
+	 * omitted.
+	 */
+	double min_length;
+
+	/**
+	 * The number of rows after which the stitch pattern repeats.
+	 * Each row's stitches are offset by length/stagger from the
+	 * previous row's.
+	 */
+	unsigned stagger = 3;
+
+	/**
+	 * If set, the needle points are accounted here before each
+	 * row is generated.
+	 */
+	ResourceBudget *budget = nullptr;
+};
+
+/**
+ * Generate tatami fill stitches for the inside of the given path
+ * (according to its fill rule).  All subpaths are implicitly closed.
+ *
+ * The shape is swept with horizontal scanlines using an active edge
+ * list, so the cost is O(E log E) for E edges plus the number of
+ * rows and stitches.  Spans of adjacent rows which overlap are
+ * connected into one run, alternating the direction.
+ *
+ * @param dest receives runs of needle points; each run can be sewn
+ * without a jump
+ */
+void
+FillStitch(std::vector<std::vector<SvgPoint>> &dest, const SvgPath &path,
+	   const FillStitchOptions &options);
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Write a synthetic SVG document to stdout.
+ */
+
+#include "SvgCorpus.hxx"
+
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void
+Usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s CLASS [SCALE] >OUTFILE.svg\n"
+		"\n"
+		"Classes:\n", argv0);
+
+	for (const auto *i = svg_corpus_classes; i->name != nullptr; ++i)
+		fprintf(stderr, "  %-10s %s\n", i->name, i->description);
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 3) {
+		Usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const auto *c = FindSvgCorpusClass(argv[1]);
+	if (c == nullptr) {
+		Usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	unsigned scale = 1;
+	if (argc > 2) {
+		char *endptr;
+		scale = strtoul(argv[2], &endptr, 10);
+		if (*endptr != 0 || scale == 0)
+			throw std::runtime_error("Malformed scale");
+	}
+
+	c->generate(stdout, scale);
+
+	if (fflush(stdout) != 0 || ferror(stdout))
+		throw std::runtime_error("Failed to write output");
+
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	fprintf(stderr, "%s\n", e.what());
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "JefColor.hxx"
+#include "Color.hxx"
+
+#include <cstdlib>
+
+namespace {
+
+/**
+ * The basic Janome thread table; the RGB values are approximations
+ * as used by other open source embroidery software.
+ */
+constexpr Color jef_colors[] = {
+	{},
+	{   0,   0,   0 }, // Black
+	{ 255, 255, 255 }, // White
+	{ 255, 255,  23 }, // Yellow
+	{ 255, 102,   0 }, // Orange
+	{  47,  89,  51 }, // Olive Green
+	{  35, 115,  54 }, // Green
+	{ 101, 194, 200 }, // Sky
+	{ 171,  90, 150 }, // Purple
+	{ 246, 105, 160 }, // Pink
+	{ 255,   0,   0 }, // Red
+	{ 177, 112,  78 }, // Brown
+	{  11,  47, 132 }, // Blue
+	{ 228, 195,  93 }, // Gold
+	{  72,  26,   5 }, // Dark Brown
+	{ 172, 156, 199 }, // Pale Violet
+	{ 252, 242, 148 }, // Pale Yellow
+	{ 249, 153, 183 }, // Pale Pink
+	{ 250, 179, 129 }, // Peach
+	{ 201, 164, 128 }, // Beige
+	{ 151,   5,  51 }, // Wine Red
+	{ 160, 184, 204 }, // Pale Sky
+	{ 127, 194,  28 }, // Yellow Green
+	{ 229, 229, 229 }, // Silver Gray
+	{ 136, 155, 155 }, // Gray
+	{ 152, 214, 189 }, // Pale Aqua
+	{ 178, 225, 227 }, // Baby Blue
+};
+
+unsigned
+ColorMatch(Color a, Color b)
+{
+	return std::abs(int(a.r) - int(b.r)) +
+		std::abs(int(a.g) - int(b.g)) +
+		std::abs(int(a.b) - int(b.b));
+}
+
+}
+
+unsigned
+NearestJefColor(Color c) noexcept
+{
+	unsigned best = 0;
+	unsigned best_diff = ~0;
+
+	for (unsigned i = 1u; i < sizeof(jef_colors) / sizeof(jef_colors[0]); ++i) {
+		unsigned diff = ColorMatch(c, jef_colors[i]);
+		if (diff < best_diff) {
+			best = i;
+			best_diff = diff;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "JefWriter.hxx"
+#include "JefColor.hxx"
+#include "PesColor.hxx"
+#include "Color.hxx"
+#include "util/ByteOrder.hxx"
+
+#include <algorithm>
+#include <array>
+
+#include <assert.h>
+#include <string.h>
+
+namespace {
+
+struct JefHoop {
+	/**
+	 * The code in the JEF header.
+	 */
+	uint32_t code;
+
+	/**
+	 * Half the size of the sewing area [PES units].
+	 */
+	int half_width, half_height;
+};
+
+/**
+ * The standard hoops, smallest first.
+ */
+constexpr JefHoop jef_hoops[] = {
+	{1, 250, 250},
+	{0, 550, 550},
+	{3, 630, 550},
+	{2, 700, 1000},
+	{4, 1000, 1000},
+};
+
+/**
+ * The distances of the design from the edges of a hoop: left, top,
+ * right, bottom.  All are -1 if it does not fit.
+ */
+struct JefHoopDistance {
+	std::array<uint32_t, 4> distance;
+
+	JefHoopDistance() = default;
+
+	JefHoopDistance(const PesBounds &bounds, const JefHoop &hoop) {
+		const int left = hoop.half_width + bounds.min_x;
+		const int top = hoop.half_height + bounds.min_y;
+		const int right = hoop.half_width - bounds.max_x;
+		const int bottom = hoop.half_height - bounds.max_y;
+
+		if (left >= 0 && top >= 0 && right >= 0 && bottom >= 0)
+			distance = {{ToLE32(left), ToLE32(top),
+				     ToLE32(right), ToLE32(bottom)}};
+		else
+			distance.fill(ToLE32(-1));
+	}
+
+	bool Fits() const {
+		return distance.front() != ToLE32(-1);
+	}
+};
+
+struct JefHeader {
+	uint32_t stitch_offset;
+	uint32_t flags = ToLE32(0x14);
+	char date[14];
+	std::array<uint8_t, 2> unknown1{{0, 0}};
+	uint32_t n_colors;
+
+	/**
+	 * The size of the stitch data in 2 byte units.
+	 */
+	uint32_t n_points;
+
+	uint32_t hoop;
+
+	/**
+	 * The distances from the center of the hoop to the edges of
+	 * the design: left, top, right, bottom.
+	 */
+	std::array<uint32_t, 4> extents;
+
+	/**
+	 * For the hoops 110x110, 50x50, 140x200 and 126x110 mm.
+	 */
+	std::array<JefHoopDistance, 4> hoop_distances;
+};
+
+static_assert(sizeof(JefHeader) == 0x74, "Wrong JEF header size");
+
+}
+
+JefWriter::JefWriter(ConstBuffer<uint8_t> pes_colors,
+		     const struct tm &_date)
+	:date(_date)
+{
+	colors.reserve(pes_colors.size);
+	for (auto i : pes_colors)
+		colors.push_back(NearestJefColor(GetPesColor(i)));
+
+	bounds.Extend(position);
+	ReserveHeader(GetHeaderSize());
+}
+
+ConstBuffer<uint8_t>
+JefWriter::Finish()
+{
+	End();
+
+	const size_t header_size = GetHeaderSize();
+
+	JefHeader header;
+	header.stitch_offset = ToLE32(header_size);
+
+	char date_buffer[32];
+	strftime(date_buffer, sizeof(date_buffer), "%Y%m%d%H%M%S", &date);
+	memcpy(header.date, date_buffer, sizeof(header.date));
+
+	header.n_colors = ToLE32(colors.size());
+	header.n_points = ToLE32((buffer.size() - header_size) / 2);
+
+	/* the smallest hoop which fits the design, or the largest
+	   one */
+	const JefHoop *hoop = std::find_if(std::begin(jef_hoops),
+					   std::end(jef_hoops),
+					   [this](const JefHoop &h){
+						   return JefHoopDistance(bounds, h).Fits();
+					   });
+	if (hoop == std::end(jef_hoops))
+		hoop = std::prev(hoop);
+	header.hoop = ToLE32(hoop->code);
+
+	header.extents = {{
+		ToLE32(-bounds.min_x),
+		ToLE32(-bounds.min_y),
+		ToLE32(bounds.max_x),
+		ToLE32(bounds.max_y),
+	}};
+
+	for (const auto &h : jef_hoops)
+		if (h.code < header.hoop_distances.size())
+			header.hoop_distances[h.code] = JefHoopDistance(bounds, h);
+
+	uint8_t *p = buffer.begin();
+	memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+
+	for (auto i : colors) {
+		const uint32_t value = ToLE32(i);
+		memcpy(p, &value, sizeof(value));
+		p += sizeof(value);
+	}
+
+	/* the thread type of each color */
+	for (size_t i = 0; i < colors.size(); ++i) {
+		const uint32_t value = ToLE32(0x0d);
+		memcpy(p, &value, sizeof(value));
+		p += sizeof(value);
+	}
+
+	assert(p == buffer.begin() + header_size);
+	return buffer;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "StitchWriter.hxx"
+#include "ExpWriter.hxx"
+#include "PesPoint.hxx"
+#include "PesBounds.hxx"
+
+#include <vector>
+
+#include <time.h>
+
+static inline uint8_t *
+JefEnd(uint8_t *p)
+{
+	*p++ = 0x80;
+	*p++ = 0x10;
+	return p;
+}
+
+/**
+ * Writes a Janome JEF file.  Stitches are encoded like EXP; the
+ * header with the thread colors, the design extents and the hoop is
+ * filled in by Finish().
+ */
+class JefWriter final : public StitchWriter<JefWriter> {
+	/**
+	 * Indexes into the Janome thread table.
+	 */
+	std::vector<unsigned> colors;
+
+	const struct tm date;
+
+	/**
+	 * The needle position relative to the start, which is the
+	 * center of the hoop.
+	 */
+	PesPoint position{0, 0};
+
+	PesBounds bounds;
+
+public:
+	static constexpr int MIN_DELTA = -127, MAX_DELTA = 127;
+
+	/**
+	 * @param pes_colors the PES color codes, which are mapped to
+	 * the nearest Janome threads
+	 * @param date the creation time for the header
+	 */
+	JefWriter(ConstBuffer<uint8_t> pes_colors, const struct tm &date);
+
+	void Stitch(int x, int y) {
+		Move(x, y);
+		GenerateWrite(ExpStitch, x, y);
+	}
+
+	void JumpStitch(int x, int y) {
+		Move(x, y);
+		GenerateWrite(ExpCommand, uint8_t(0x02), x, y);
+	}
+
+	void TrimStitch(int x, int y) {
+		/* JEF has no trim command; Janome machines cut the
+		   thread before jumps */
+		JumpStitch(x, y);
+	}
+
+	void ColorChange(unsigned index) {
+		/* the first color needs no command */
+		if (index > 0)
+			GenerateWrite(ExpCommand, uint8_t(0x01), 0, 0);
+	}
+
+	void End() {
+		GenerateWrite(JefEnd);
+	}
+
+	/**
+	 * Write the end mark and fill in the header.
+	 */
+	ConstBuffer<uint8_t> Finish();
+
+private:
+	void Move(int x, int y) {
+		position.x += x;
+		position.y += y;
+		bounds.Extend(position);
+	}
+
+	size_t GetHeaderSize() const {
+		return 0x74 + colors.size() * 8;
+	}
+};
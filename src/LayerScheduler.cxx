@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "LayerScheduler.hxx"
+#include "PesBounds.hxx"
+#include "ResourceBudget.hxx"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <queue>
+#include <set>
+
+namespace {
+
+PesBounds
+GetBounds(const std::vector<StitchRun> &runs)
+{
+	PesBounds bounds;
+	for (const auto &run : runs)
+		bounds.Extend({run.points.data(), run.points.size()});
+	return bounds;
+}
+
+void
+MoveRuns(StitchBlock &dest, StitchBlock &src)
+{
+	if (dest.runs.empty())
+		dest.runs = std::move(src.runs);
+	else
+		std::move(src.runs.begin(), src.runs.end(),
+			  std::back_inserter(dest.runs));
+
+	src.runs.clear();
+}
+
+/**
+ * The layers of one color which overlap the sweep line.
+ *
+ * As long as there are only a few, each of them which overlaps a
+ * layer of another color gets its own edge.  When there are many
+ * (i.e. many layers of this color overlap each other), they are
+ * chained in document order instead; then an edge from (or to) the
+ * nearest overlapping one implies all the others, and the number of
+ * edges stays linear even if all layers overlap.  That constrains
+ * the order of the layers within this color, which may cost a color
+ * change here and there, but only where the layers are dense.
+ */
+class ActiveLayers {
+	static constexpr size_t MAX_UNCHAINED = 32;
+
+	/**
+	 * The layer indices, i.e. in document order.
+	 */
+	std::set<unsigned> layers;
+
+	/**
+	 * Are all #layers chained by edges in document order?
+	 */
+	bool chained = false;
+
+public:
+	void Add(std::vector<std::pair<unsigned, unsigned>> &edges,
+		 unsigned i) {
+		const auto k = layers.insert(i).first;
+
+		if (chained) {
+			if (k != layers.begin())
+				edges.emplace_back(*std::prev(k), i);
+			if (std::next(k) != layers.end())
+				edges.emplace_back(i, *std::next(k));
+		} else if (layers.size() > MAX_UNCHAINED) {
+			for (auto j = std::next(layers.begin());
+			     j != layers.end(); ++j)
+				edges.emplace_back(*std::prev(j), *j);
+			chained = true;
+		}
+	}
+
+	void Remove(unsigned i) {
+		layers.erase(i);
+
+		/* the remaining layers are still chained (through
+		   the removed ones), but without a chain, this
+		   object is cheaper again */
+		if (layers.size() < MAX_UNCHAINED / 2)
+			chained = false;
+	}
+
+	/**
+	 * Add the edges between the given layer (which has another
+	 * color and overlaps the sweep line) and these layers.
+	 */
+	void AddEdges(std::vector<std::pair<unsigned, unsigned>> &edges,
+		      const std::vector<PesBounds> &boxes,
+		      unsigned i) const {
+		const PesBounds &box = boxes[i];
+
+		if (!chained) {
+			for (const unsigned a : layers)
+				if (boxes[a].OverlapsY(box))
+					edges.emplace_back(std::min(a, i),
+							   std::max(a, i));
+			return;
+		}
+
+		const auto upper = layers.lower_bound(i);
+
+		for (auto j = upper; j != layers.begin();) {
+			--j;
+			if (boxes[*j].OverlapsY(box)) {
+				edges.emplace_back(*j, i);
+				break;
+			}
+		}
+
+		for (auto j = upper; j != layers.end(); ++j) {
+			if (boxes[*j].OverlapsY(box)) {
+				edges.emplace_back(i, *j);
+				break;
+			}
+		}
+	}
+};
+
+}
+
+std::vector<StitchBlock>
+ScheduleLayers(std::vector<StitchBlock> &layers, ResourceBudget *budget)
+{
+	const unsigned n = layers.size();
+
+	std::vector<PesBounds> boxes;
+	boxes.reserve(n);
+	for (const auto &i : layers)
+		boxes.push_back(GetBounds(i.runs));
+
+	/* sweep along the x axis and find all overlapping pairs of
+	   different colors; each pair needs an edge from the lower to
+	   the upper layer */
+	std::vector<unsigned> by_x;
+	by_x.reserve(n);
+	for (unsigned i = 0; i < n; ++i)
+		if (!boxes[i].IsEmpty())
+			by_x.push_back(i);
+
+	std::sort(by_x.begin(), by_x.end(), [&boxes](unsigned a, unsigned b){
+			return boxes[a].min_x < boxes[b].min_x;
+		});
+
+	std::vector<std::pair<unsigned, unsigned>> edges;
+	std::map<unsigned, ActiveLayers> active;
+
+	/* the active layers, the one which ends first on top */
+	using Expiry = std::pair<int, unsigned>;
+	std::priority_queue<Expiry, std::vector<Expiry>,
+			    std::greater<Expiry>> expiry;
+
+	for (const unsigned i : by_x) {
+		if (budget != nullptr)
+			budget->CheckTime();
+
+		const PesBounds &box = boxes[i];
+
+		while (!expiry.empty() && expiry.top().first < box.min_x) {
+			const unsigned a = expiry.top().second;
+			active[layers[a].color].Remove(a);
+			expiry.pop();
+		}
+
+		for (const auto &c : active)
+			if (c.first != layers[i].color)
+				c.second.AddEdges(edges, boxes, i);
+
+		active[layers[i].color].Add(edges, i);
+		expiry.emplace(box.max_x, i);
+	}
+
+	/* build the successor lists */
+	std::vector<unsigned> offsets(n + 1, 0), in_degree(n, 0);
+	for (const auto &e : edges) {
+		++offsets[e.first + 1];
+		++in_degree[e.second];
+	}
+
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+	std::vector<unsigned> successors(edges.size());
+	{
+		std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+		for (const auto &e : edges)
+			successors[fill[e.first]++] = e.second;
+	}
+
+	edges.clear();
+	edges.shrink_to_fit();
+
+	/* topological sort, grouping as many layers of one color as
+	   possible */
+	std::map<unsigned, std::vector<unsigned>> ready;
+	for (const unsigned i : by_x)
+		if (in_degree[i] == 0)
+			ready[layers[i].color].push_back(i);
+
+	std::vector<StitchBlock> blocks;
+
+	while (true) {
+		auto best = ready.end();
+		for (auto i = ready.begin(); i != ready.end(); ++i)
+			if (!i->second.empty() &&
+			    (best == ready.end() ||
+			     i->second.size() > best->second.size()))
+				best = i;
+
+		if (best == ready.end())
+			break;
+
+		const unsigned color = best->first;
+		blocks.emplace_back(color);
+		StitchBlock &block = blocks.back();
+
+		std::vector<unsigned> batch;
+		while (!best->second.empty()) {
+			batch.clear();
+			batch.swap(best->second);
+
+			/* keep the document order within the block */
+			std::sort(batch.begin(), batch.end());
+
+			for (const unsigned i : batch) {
+				if (budget != nullptr)
+					budget->CheckTime();
+
+				MoveRuns(block, layers[i]);
+
+				for (unsigned j = offsets[i]; j < offsets[i + 1]; ++j) {
+					const unsigned s = successors[j];
+					if (--in_degree[s] == 0)
+						ready[layers[s].color].push_back(s);
+				}
+			}
+		}
+	}
+
+	return blocks;
+}
+
+std::vector<StitchBlock>
+GroupLayersByColor(std::vector<StitchBlock> &layers)
+{
+	std::map<unsigned, StitchBlock> by_color;
+	for (auto &i : layers) {
+		if (i.runs.empty())
+			continue;
+
+		auto j = by_color.emplace(i.color, StitchBlock(i.color)).first;
+		MoveRuns(j->second, i);
+	}
+
+	std::vector<StitchBlock> blocks;
+	blocks.reserve(by_color.size());
+	for (auto &i : by_color)
+		blocks.push_back(std::move(i.second));
+
+	return blocks;
+}
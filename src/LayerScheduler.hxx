@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "StitchBlock.hxx"
+
+#include <vector>
+
+class ResourceBudget;
+
+/**
+ * Combine layers (given in z-order, bottom first) into as few color
+ * blocks as possible without sewing a layer before another layer of
+ * a different color which is below it and overlaps it.
+ *
+ * Overlaps are found by comparing bounding boxes with a
+ * sweep-and-prune pass along the x axis.  Where many layers of one
+ * color overlap, they keep their document order, which keeps the
+ * number of constraints linear.  The blocks are then built by a
+ * topological sort which always continues with the color that has
+ * the most layers ready, and keeps adding layers of that color while
+ * their constraints allow it.  This is a heuristic; finding the true
+ * minimum is NP-hard in general.
+ *
+ * The runs are moved out of the layers.
+ *
+ * @param budget if not nullptr, the time limit is checked
+ */
+std::vector<StitchBlock>
+ScheduleLayers(std::vector<StitchBlock> &layers, ResourceBudget *budget);
+
+/**
+ * Group all layers by their color, ignoring the z-order.  This has
+ * the least color changes, but layers may be sewn on top of layers
+ * which should be above them.
+ *
+ * The runs are moved out of the layers.
+ */
+std::vector<StitchBlock>
+GroupLayersByColor(std::vector<StitchBlock> &layers);
@@ -19,18 +19,50 @@
 #include "SvgParser.hxx"
 #include "SvgData.hxx"
 #include "PesWriter.hxx"
-#include "PesColor.hxx"
+#include "DstWriter.hxx"
+#include "ExpWriter.hxx"
+#include "JefWriter.hxx"
+#include "PecGraphic.hxx"
+#include "PesPoint.hxx"
+#include "PesReader.hxx"
+#include "PesVerify.hxx"
+#include "PesRender.hxx"
+#include "Stitcher.hxx"
+#include "StitchRun.hxx"
+#include "StitchEncoder.hxx"
+#include "SpillEncoder.hxx"
+#include "ResourceBudget.hxx"
+#include "SvgPrescan.hxx"
+#include "ConversionStats.hxx"
+#include "Trace.hxx"
+#include "MemoryStats.hxx"
+#include "StitchBlock.hxx"
+#include "PesBounds.hxx"
+#include "LayerScheduler.hxx"
+#include "RunOrder.hxx"
+#include "SewingCost.hxx"
+#include "MappedFile.hxx"
 #include "util/SystemError.hxx"
 #include "util/ScopeExit.hxx"
 
 #include <stdexcept>
-#include <map>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <getopt.h>
 #include <math.h>
+#include <time.h>
 
 static void
 FeedFile(SvgParser &parser, int fd)
@@ -61,6 +93,75 @@ FeedFile(SvgParser &parser, const char *path)
 	FeedFile(parser, fd);
 }
 
+/**
+ * Parse the file with the built-in in-situ tokenizer.  If that
+ * rejects the document, start over with a new parser and Expat.
+ * Files which cannot be mapped (e.g. pipes) are parsed with Expat
+ * right away.
+ */
+template<typename F>
+static std::unique_ptr<SvgParser>
+ParseFileInSitu(const char *path, F &&make_parser)
+{
+	auto parser = make_parser();
+
+	{
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+			throw FormatErrno("Failed to open %s", path);
+
+		AtScopeExit(fd) { close(fd); };
+
+		struct stat st;
+		if (fstat(fd, &st) < 0)
+			throw FormatErrno("Failed to stat %s", path);
+
+		/* read a pipe only once; opening it again would
+		   miss the data consumed here */
+		if (!S_ISREG(st.st_mode)) {
+			FeedFile(*parser, fd);
+			return parser;
+		}
+	}
+
+	try {
+		MappedFile file(path, true);
+		parser->ParseInSitu((char *)file.GetData(), file.GetSize());
+	} catch (const XmlTokenizerError &) {
+		parser = make_parser();
+		FeedFile(*parser, path);
+	}
+
+	return parser;
+}
+
+/**
+ * The creation date for file headers: $SOURCE_DATE_EPOCH (in UTC) if
+ * set, so the output is reproducible, or else the current local
+ * time.
+ */
+static struct tm
+GetCreationDate()
+{
+	struct tm tm;
+
+	const char *s = getenv("SOURCE_DATE_EPOCH");
+	if (s != nullptr && *s != 0) {
+		char *endptr;
+		const unsigned long long value = strtoull(s, &endptr, 10);
+		const time_t t = time_t(value);
+		if (endptr == s || *endptr != 0 || *s == '-' ||
+		    t < 0 || (unsigned long long)t != value ||
+		    gmtime_r(&t, &tm) == nullptr)
+			throw std::runtime_error("Malformed SOURCE_DATE_EPOCH");
+	} else {
+		const time_t t = time(nullptr);
+		localtime_r(&t, &tm);
+	}
+
+	return tm;
+}
+
 static void
 WriteFile(int fd, ConstBuffer<uint8_t> src)
 {
@@ -72,136 +173,791 @@ WriteFile(int fd, ConstBuffer<uint8_t> src)
 		throw std::runtime_error("Short write to file");
 }
 
-static void
-WriteFile(const char *path, ConstBuffer<uint8_t> src)
+static int
+CreateFile(const char *path)
 {
 	int fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
 	if (fd < 0)
 		throw FormatErrno("Failed to create %s", path);
 
+	return fd;
+}
+
+static void
+WriteFile(const char *path, ConstBuffer<uint8_t> src)
+{
+	int fd = CreateFile(path);
+
 	AtScopeExit(fd) { close(fd); };
 	WriteFile(fd, src);
 }
 
+gcc_pure
+static double
+GetDistance(PesPoint a, PesPoint b)
+{
+	return hypot(a.x - b.x, a.y - b.y);
+}
+
 /**
- * A point in a PES file.
+ * Order the runs of each block and choose the transitions between
+ * them.  The result is encoded into each output format.
+ *
+ * @param cursor the initial needle position
  */
-struct PesPoint {
-	int x, y;
-
-	PesPoint() = default;
-	constexpr PesPoint(int _x, int _y)
-		:x(_x), y(_y) {}
-
-	/**
-	 * Import from a SVG point, scaling to PES coordinates.
-	 */
-#if defined(__GNUC__) && !defined(__clang__)
-	constexpr
-#endif
-	PesPoint(SvgPoint src):x(FromSvg(src.x)), y(FromSvg(src.y)) {}
+static void
+PlanStitches(PesPoint cursor, const RunOrderOptions *order_options,
+	     const SewingCostModel &cost, SewingEstimate &estimate,
+	     std::vector<StitchBlock> &blocks)
+{
+	bool first_block = true;
+	for (auto &i : blocks) {
+		if (!first_block)
+			++estimate.color_changes;
+		first_block = false;
+
+		auto &runs = i.runs;
+		if (order_options != nullptr) {
+			const ScopeMemorySubsystem scope(MemorySubsystem::STITCHES);
+			OrderRuns(runs, cursor, *order_options);
+		}
 
-	constexpr PesPoint operator+(PesPoint other) const {
-		return {x + other.x, y + other.y};
+		bool first = true;
+		for (auto &run : runs) {
+			const double distance = GetDistance(cursor,
+							    run.GetStart());
+
+			if (first) {
+				/* the thread has just been changed, no
+				   need to trim */
+				run.transition = Transition::JUMP;
+				estimate.AddJump(distance);
+				first = false;
+			} else {
+				run.transition = cost.ChooseTransition(distance);
+				estimate.AddTransition(cost, run.transition,
+						       distance);
+			}
+
+			cursor = run.GetEnd();
+			estimate.stitches += run.points.size() - 1;
+		}
 	}
+}
 
-	constexpr PesPoint operator-(PesPoint other) const {
-		return {x - other.x, y - other.y};
-	}
+enum class OutputFormat {
+	PES,
+	DST,
+	EXP,
+	JEF,
+};
+
+/**
+ * Determine the output format from the file name suffix; PES is the
+ * default.
+ */
+gcc_pure
+static OutputFormat
+GetOutputFormat(const char *path)
+{
+	const char *dot = strrchr(path, '.');
+	if (dot == nullptr || strchr(dot, '/') != nullptr)
+		return OutputFormat::PES;
+
+	if (strcasecmp(dot, ".dst") == 0)
+		return OutputFormat::DST;
+	else if (strcasecmp(dot, ".exp") == 0)
+		return OutputFormat::EXP;
+	else if (strcasecmp(dot, ".jef") == 0)
+		return OutputFormat::JEF;
+	else
+		return OutputFormat::PES;
+}
+
+/**
+ * The file name without directory and suffix, for file headers.
+ */
+gcc_pure
+static std::string
+GetDesignName(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	std::string name(slash != nullptr ? slash + 1 : path);
+	const auto dot = name.rfind('.');
+	if (dot != std::string::npos && dot > 0)
+		name.erase(dot);
+	return name;
+}
 
-	PesPoint &operator+=(PesPoint other) {
-		x += other.x;
-		y += other.y;
-		return *this;
+/**
+ * Encode the planned blocks with the given writer and write the
+ * result to a file.
+ *
+ * @param finish a function which finishes encoding and returns the
+ * file contents
+ */
+template<typename W, typename F>
+static void
+EncodeFile(ConversionStats &stats, const char *path, W &writer,
+	   PesPoint origin, const std::vector<StitchBlock> &blocks,
+	   PecGraphic *graphic, F &&finish)
+{
+	ConstBuffer<uint8_t> data;
+	{
+		const ScopePhaseTimer timer(stats, ConversionPhase::ENCODE);
+		EncodeBlocks(writer, origin, blocks, graphic);
+		data = finish();
 	}
 
-private:
-#if defined(__GNUC__) && !defined(__clang__)
-	/* lround() is a constexpr built-in in GCC */
-	constexpr
-#endif
-	static int FromSvg(double value) {
-		constexpr double SCALE = 25.4*10/90; //SVG 90DPI and PES 10 points per mm
-		return lround(value * SCALE);
+	{
+		const ScopePhaseTimer timer(stats, ConversionPhase::WRITE);
+		WriteFile(path, data);
 	}
-};
+
+	stats.output_bytes += data.size;
+}
+
+gcc_pure
+static PesBounds
+GetBounds(const std::vector<StitchBlock> &blocks)
+{
+	PesBounds bounds;
+	for (const auto &block : blocks)
+		for (const auto &run : block.runs)
+			bounds.Extend({run.points.data(), run.points.size()});
+	return bounds;
+}
 
 static void
-SvgToPes(PesWriter &pes, PesPoint &cursor, const SvgPath &path)
+PrintEstimate(const SewingEstimate &estimate, const SewingCostModel &cost,
+	      const PesBounds &bounds)
 {
-	bool first = true;
-	for (const auto &svg_point : path.points) {
-		const PesPoint point(svg_point);
-		auto relative = point - cursor;
-		cursor = point;
+	const unsigned long seconds = lround(estimate.GetSeconds(cost));
+
+	printf("Estimated sewing time: %lu:%02lu\n"
+	       "width = %.1f mm\n"
+	       "height = %.1f mm\n"
+	       "stitches = %lu\n"
+	       "jumps = %lu\n"
+	       "trims = %lu\n"
+	       "manual_trims = %lu\n"
+	       "color_changes = %u\n",
+	       seconds / 60, seconds % 60,
+	       bounds.GetWidth() / 10., bounds.GetHeight() / 10.,
+	       estimate.stitches, estimate.jumps, estimate.trims,
+	       estimate.manual_trims, estimate.color_changes);
+}
 
-		bool move = first ||
-			svg_point.type == SvgVertex::Type::MOVE;
-		first = false;
+static void
+PrintComplexity(const char *path)
+{
+	MappedFile file(path);
+	const auto c = EstimateSvgComplexity((const char *)file.GetData(),
+					     file.GetSize());
+
+	printf("bytes = %zu\n"
+	       "elements = %zu\n"
+	       "max_depth = %u\n"
+	       "path_segments = %zu\n"
+	       "vertices = %zu\n"
+	       "entities = %zu\n",
+	       file.GetSize(), c.elements, c.max_depth,
+	       c.path_segments, c.vertices, c.entities);
+}
 
-		if (move) {
-			pes.Jump(relative.x, relative.y);
-		} else
-			pes.StitchLine(relative.x, relative.y);
-	}
+static void
+PrintMemoryStats(const char *in_path, bool json)
+{
+#ifdef ENABLE_MEMORY_STATS
+	struct stat st;
+	PrintMemoryStats(stderr, json,
+			 stat(in_path, &st) == 0 ? st.st_size : 0);
+#else
+	(void)in_path;
+	(void)json;
+#endif
+}
+
+static void
+Usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] INFILE.svg OUTFILE...\n"
+		"       %s --prescan INFILE.svg\n"
+		"\n"
+		"The format of each output file is chosen by its suffix: .dst (Tajima),\n"
+		".exp (Melco), .jef (Janome), PES otherwise.\n"
+		"\n"
+		"Options:\n"
+		"  --stitch-length=MM      target running stitch length (default 2.5)\n"
+		"  --min-stitch-length=MM  minimum stitch length (default 0.3)\n"
+		"  --fill-spacing=MM       distance between fill rows (default 0.4)\n"
+		"  --order=MODE            path order within a color: document, greedy,\n"
+		"                          2opt (default)\n"
+		"  --ignore-z-order        group all paths of one color, even if that sews\n"
+		"                          them on top of paths which should be above\n"
+		"  --center                center the design in the hoop\n"
+		"  --no-thumbnails         omit the PEC thumbnails from PES files; they\n"
+		"                          cannot be stored if the stitches take more\n"
+		"                          than 16 MB\n"
+		"  --no-cull               keep elements outside of the SVG viewport\n"
+		"  --fast-xml              parse with the built-in XML tokenizer, falling\n"
+		"                          back to Expat if it cannot handle the file\n"
+		"  --max-memory=MB         convert huge files with bounded memory, keeping\n"
+		"                          at most MB of stitches in memory and the rest\n"
+		"                          in temporary files; sews each color's paths in\n"
+		"                          document order\n"
+		"  --speed=SPM             machine speed in stitches per minute (default 600)\n"
+		"  --estimate              print the estimated sewing time\n"
+		"  --verify                read the PES output file back and check that\n"
+		"                          it sews exactly the generated stitches\n"
+		"  --preview=FILE          draw the stitches of the PES output to a PPM\n"
+		"                          file\n"
+		"  --preview-size=PIXELS   the size of the longer side of the preview\n"
+		"                          (default 1000)\n"
+		"  --stats[=FORMAT]        print timers and counters to stderr; FORMAT is\n"
+		"                          text (default) or json\n"
+#ifdef ENABLE_MEMORY_STATS
+		"  --memory-stats[=FORMAT] print heap usage by subsystem and phase to\n"
+		"                          stderr; FORMAT is text (default) or json\n"
+#endif
+#ifdef ENABLE_TRACE
+		"  --trace=FILE            write a Chrome trace of the conversion to FILE\n"
+#endif
+		"  --prescan               print a quick complexity estimate of the\n"
+		"                          input file instead of converting it\n"
+		"\n"
+		"Limits (the conversion fails if one is exceeded):\n"
+		"  --max-vertices=N        vertices after tessellating all shapes\n"
+		"  --max-depth=N           nesting depth of elements\n"
+		"  --max-stitches=N        generated needle points\n"
+		"  --timeout=SECONDS       wall time\n"
+		"  --max-amplification=F   ratio of expanded XML entities to input size\n",
+		argv0, argv0);
 }
 
 static void
-SvgToPes(PesWriter &pes, const std::multimap<unsigned, const SvgPath &> &paths)
+WritePreview(const PesReader &reader, const char *path, unsigned size)
 {
-	PesPoint cursor(0, 0);
+	std::vector<PesStitch> stitches;
+	reader.Decode(stitches);
 
-	unsigned last_color = 0;
-	unsigned next_color_index = 0;
-	for (const auto &i : paths) {
-		if (i.first != last_color) {
-			last_color = i.first;
-			pes.ColorChange(next_color_index++);
-		}
+	RenderPes(reader, stitches, size, std::thread::hardware_concurrency())
+		.WritePpm(path);
+}
 
-		SvgToPes(pes, cursor, i.second);
-	}
+/**
+ * Parse the argument of --stats.
+ *
+ * @return true for JSON, false for text
+ */
+static bool
+ParseStatsFormat(const char *s)
+{
+	if (s == nullptr || strcmp(s, "text") == 0)
+		return false;
+	else if (strcmp(s, "json") == 0)
+		return true;
+	else
+		throw std::runtime_error("Unknown stats format");
+}
+
+static unsigned long
+ParseCount(const char *s)
+{
+	char *endptr;
+	unsigned long value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0 || value == 0)
+		throw std::runtime_error("Malformed number");
+
+	return value;
+}
+
+static double
+ParsePositive(const char *s)
+{
+	char *endptr;
+	double value = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0 || !(value > 0))
+		throw std::runtime_error("Malformed number");
+
+	return value;
+}
+
+static double
+ParseLength(const char *s)
+{
+	char *endptr;
+	double value = strtod(s, &endptr);
+	if (endptr == s || *endptr != 0 || !(value >= 0))
+		throw std::runtime_error("Malformed length");
+
+	return MillimetersToSvg(value);
 }
 
 int
 main(int argc, char **argv)
 try {
-	if (argc != 3) {
-		fprintf(stderr, "Usage: %s INFILE.svg OUTFILE.pes\n", argv[0]);
+	enum {
+		OPTION_STITCH_LENGTH = 0x100,
+		OPTION_MIN_STITCH_LENGTH,
+		OPTION_FILL_SPACING,
+		OPTION_ORDER,
+		OPTION_IGNORE_Z_ORDER,
+		OPTION_CENTER,
+		OPTION_NO_THUMBNAILS,
+		OPTION_NO_CULL,
+		OPTION_FAST_XML,
+		OPTION_MAX_MEMORY,
+		OPTION_SPEED,
+		OPTION_ESTIMATE,
+		OPTION_VERIFY,
+		OPTION_PREVIEW,
+		OPTION_PREVIEW_SIZE,
+		OPTION_STATS,
+		OPTION_MEMORY_STATS,
+		OPTION_TRACE,
+		OPTION_PRESCAN,
+		OPTION_MAX_VERTICES,
+		OPTION_MAX_DEPTH,
+		OPTION_MAX_STITCHES,
+		OPTION_TIMEOUT,
+		OPTION_MAX_AMPLIFICATION,
+	};
+
+	static const struct option long_options[] = {
+		{"stitch-length", required_argument, nullptr, OPTION_STITCH_LENGTH},
+		{"min-stitch-length", required_argument, nullptr, OPTION_MIN_STITCH_LENGTH},
+		{"fill-spacing", required_argument, nullptr, OPTION_FILL_SPACING},
+		{"order", required_argument, nullptr, OPTION_ORDER},
+		{"ignore-z-order", no_argument, nullptr, OPTION_IGNORE_Z_ORDER},
+		{"center", no_argument, nullptr, OPTION_CENTER},
+		{"no-thumbnails", no_argument, nullptr, OPTION_NO_THUMBNAILS},
+		{"no-cull", no_argument, nullptr, OPTION_NO_CULL},
+		{"fast-xml", no_argument, nullptr, OPTION_FAST_XML},
+		{"max-memory", required_argument, nullptr, OPTION_MAX_MEMORY},
+		{"speed", required_argument, nullptr, OPTION_SPEED},
+		{"estimate", no_argument, nullptr, OPTION_ESTIMATE},
+		{"verify", no_argument, nullptr, OPTION_VERIFY},
+		{"preview", required_argument, nullptr, OPTION_PREVIEW},
+		{"preview-size", required_argument, nullptr, OPTION_PREVIEW_SIZE},
+		{"stats", optional_argument, nullptr, OPTION_STATS},
+		{"memory-stats", optional_argument, nullptr, OPTION_MEMORY_STATS},
+		{"trace", required_argument, nullptr, OPTION_TRACE},
+		{"prescan", no_argument, nullptr, OPTION_PRESCAN},
+		{"max-vertices", required_argument, nullptr, OPTION_MAX_VERTICES},
+		{"max-depth", required_argument, nullptr, OPTION_MAX_DEPTH},
+		{"max-stitches", required_argument, nullptr, OPTION_MAX_STITCHES},
+		{"timeout", required_argument, nullptr, OPTION_TIMEOUT},
+		{"max-amplification", required_argument, nullptr, OPTION_MAX_AMPLIFICATION},
+		{nullptr, 0, nullptr, 0}
+	};
+
+	StitchOptions stitch_options;
+	SewingCostModel cost;
+	RunOrderOptions order_options;
+	order_options.cost = &cost;
+	bool reorder = true;
+	bool ignore_z_order = false;
+	bool center = false;
+	bool thumbnails = true;
+	bool cull = true;
+	bool fast_xml = false;
+	bool print_estimate = false;
+	bool verify = false;
+	const char *preview_path = nullptr;
+	unsigned preview_size = 1000;
+	bool print_stats = false, json_stats = false;
+	bool print_memory_stats = false, json_memory_stats = false;
+	bool prescan = false;
+	size_t max_memory = 0;
+	ResourceLimits limits;
+
+	int o;
+	while ((o = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+		switch (o) {
+		case OPTION_STITCH_LENGTH:
+			stitch_options.length = ParseLength(optarg);
+			if (stitch_options.length <= 0)
+				throw std::runtime_error("Stitch length must be positive");
+			break;
+
+		case OPTION_MIN_STITCH_LENGTH:
+			stitch_options.min_length = ParseLength(optarg);
+			break;
+
+		case OPTION_FILL_SPACING:
+			stitch_options.fill_spacing = ParseLength(optarg);
+			if (stitch_options.fill_spacing <= 0)
+				throw std::runtime_error("Fill spacing must be positive");
+			break;
+
+		case OPTION_ORDER:
+			if (strcmp(optarg, "document") == 0)
+				reorder = false;
+			else if (strcmp(optarg, "greedy") == 0) {
+				reorder = true;
+				order_options.two_opt = false;
+			} else if (strcmp(optarg, "2opt") == 0) {
+				reorder = true;
+				order_options.two_opt = true;
+			} else
+				throw std::runtime_error("Unknown order mode");
+			break;
+
+		case OPTION_IGNORE_Z_ORDER:
+			ignore_z_order = true;
+			break;
+
+		case OPTION_CENTER:
+			center = true;
+			break;
+
+		case OPTION_NO_THUMBNAILS:
+			thumbnails = false;
+			break;
+
+		case OPTION_NO_CULL:
+			cull = false;
+			break;
+
+		case OPTION_FAST_XML:
+			fast_xml = true;
+			break;
+
+		case OPTION_MAX_MEMORY:
+			max_memory = size_t(ParseCount(optarg)) << 20;
+			break;
+
+		case OPTION_SPEED:
+			cost.stitches_per_minute = ParsePositive(optarg);
+			break;
+
+		case OPTION_ESTIMATE:
+			print_estimate = true;
+			break;
+
+		case OPTION_VERIFY:
+			verify = true;
+			break;
+
+		case OPTION_PREVIEW:
+			preview_path = optarg;
+			break;
+
+		case OPTION_PREVIEW_SIZE:
+			preview_size = ParseCount(optarg);
+			break;
+
+		case OPTION_STATS:
+			print_stats = true;
+			json_stats = ParseStatsFormat(optarg);
+			break;
+
+		case OPTION_MEMORY_STATS:
+#ifdef ENABLE_MEMORY_STATS
+			print_memory_stats = true;
+			json_memory_stats = ParseStatsFormat(optarg);
+			break;
+#else
+			throw std::runtime_error("Memory statistics are not available in this build");
+#endif
+
+		case OPTION_TRACE:
+#ifdef ENABLE_TRACE
+			EnableTrace(optarg);
+			break;
+#else
+			throw std::runtime_error("Tracing is not available in this build");
+#endif
+
+		case OPTION_PRESCAN:
+			prescan = true;
+			break;
+
+		case OPTION_MAX_VERTICES:
+			limits.max_vertices = ParseCount(optarg);
+			break;
+
+		case OPTION_MAX_DEPTH:
+			limits.max_depth = ParseCount(optarg);
+			break;
+
+		case OPTION_MAX_STITCHES:
+			limits.max_stitches = ParseCount(optarg);
+			break;
+
+		case OPTION_TIMEOUT:
+			limits.max_seconds = ParsePositive(optarg);
+			break;
+
+		case OPTION_MAX_AMPLIFICATION:
+			limits.max_amplification = ParsePositive(optarg);
+			break;
+
+		default:
+			Usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (prescan && argc - optind == 1) {
+		PrintComplexity(argv[optind]);
+		return EXIT_SUCCESS;
+	}
+
+	if (prescan || argc - optind < 2) {
+		Usage(argv[0]);
 		return EXIT_FAILURE;
 	}
 
-	const auto in_path = argv[1];
-	const auto out_path = argv[2];
+	if (stitch_options.min_length > stitch_options.length)
+		stitch_options.min_length = stitch_options.length;
+
+	const auto in_path = argv[optind];
+	const ConstBuffer<char *> out_paths(argv + optind + 1,
+					    argc - optind - 1);
+
+	/* --verify and --preview read the first PES file */
+	const char *pes_path = nullptr;
+	for (const char *path : out_paths) {
+		if (GetOutputFormat(path) == OutputFormat::PES) {
+			pes_path = path;
+			break;
+		}
+	}
+
+	if ((verify || preview_path != nullptr) && pes_path == nullptr)
+		throw std::runtime_error("--verify and --preview need a PES output file");
+
+	if (max_memory > 0 && (out_paths.size != 1 || pes_path == nullptr))
+		throw std::runtime_error("--max-memory supports only one PES output file");
+
+	/* the clock starts now */
+	ResourceBudget budget(limits);
+	stitch_options.budget = &budget;
+	order_options.budget = &budget;
+
+	auto make_parser = [cull, &budget](){
+		std::unique_ptr<SvgParser> parser(new SvgParser());
+		if (!cull)
+			parser->DisableCulling();
+		/* a fallback parser starts over */
+		budget.ResetVertices();
+		parser->SetBudget(budget);
+		return parser;
+	};
+
+	ConversionStats stats;
+
+	if (max_memory > 0) {
+		/* stream the document through Expat; the in-situ
+		   tokenizer would need the whole file in memory, and
+		   its Expat fallback would see the first paths twice */
+		/* each of the parser's two caches gets an eighth of
+		   the limit, and the stitch buffers the rest */
+		const size_t max_cache = max_memory / 8;
+
+		SewingEstimate &estimate = stats.sewing;
+		SpillEncoder encoder(stitch_options, cost, estimate,
+				     max_memory - 2 * max_cache);
+
+		{
+			/* stitching and encoding happen while
+			   parsing, so this is all accounted as
+			   "parse" */
+			const ScopePhaseTimer timer(stats,
+						    ConversionPhase::PARSE);
+			auto parser = make_parser();
+			parser->SetPathHandler(encoder);
+			parser->SetCacheLimit(max_cache);
+			FeedFile(*parser, in_path);
+			stats.parser = parser->GetStats();
+		}
+
+		{
+			const ScopePhaseTimer timer(stats,
+						    ConversionPhase::WRITE);
+			int fd = CreateFile(pes_path);
+			AtScopeExit(fd) { close(fd); };
+			encoder.Finish(fd, center, thumbnails);
+			stats.output_bytes = lseek(fd, 0, SEEK_CUR);
+		}
+
+		/* the stitches are gone, so only the consistency of
+		   the file can be checked */
+		if (verify || preview_path != nullptr) {
+			const PesFile file(pes_path);
+			if (verify)
+				VerifyPes(file.GetReader());
+			if (preview_path != nullptr)
+				WritePreview(file.GetReader(), preview_path,
+					     preview_size);
+		}
+
+		stats.runs = encoder.GetRunCount();
+		stats.blocks = encoder.GetColorCount();
+
+		if (print_estimate)
+			PrintEstimate(estimate, cost, encoder.GetBounds());
+
+		if (print_stats)
+			stats.Print(stderr, json_stats);
 
-	SvgParser parser;
-	FeedFile(parser, in_path);
+		if (print_memory_stats)
+			PrintMemoryStats(in_path, json_memory_stats);
 
-	std::multimap<unsigned, const SvgPath &> paths;
-	for (const auto &path : parser.GetPaths()) {
-		Color rgb;
-		if (path.stroke)
-			rgb = path.stroke_color;
-		else if (path.fill)
-			rgb = path.fill_color;
-		else
-			continue;
+		return EXIT_SUCCESS;
+	}
 
-		unsigned color = NearestPesColor(rgb);
-		paths.emplace(color, path);
+	std::unique_ptr<SvgParser> parser;
+	{
+		const ScopePhaseTimer timer(stats, ConversionPhase::PARSE);
+		if (fast_xml)
+			parser = ParseFileInSitu(in_path, make_parser);
+		else {
+			parser = make_parser();
+			FeedFile(*parser, in_path);
+		}
+	}
+
+	stats.parser = parser->GetStats();
+
+	/* the parser returns the paths in reverse document order */
+	std::vector<const SvgPath *> document;
+	for (const auto &path : parser->GetPaths())
+		document.push_back(&path);
+	std::reverse(document.begin(), document.end());
+
+	/* the fill is sewn first, and the outline on top of it */
+	std::vector<StitchBlock> layers;
+	{
+		const ScopePhaseTimer timer(stats, ConversionPhase::STITCH);
+		const ScopeMemorySubsystem scope(MemorySubsystem::STITCHES);
+		for (const SvgPath *path : document) {
+			if (path->fill) {
+				layers.emplace_back(path->fill_pes_color);
+				FillToRuns(layers.back().runs, *path,
+					   stitch_options);
+			}
+
+			if (path->stroke) {
+				layers.emplace_back(path->stroke_pes_color);
+				StrokeToRuns(layers.back().runs, *path,
+					     stitch_options);
+			}
+		}
+	}
+
+	for (const auto &i : layers)
+		stats.runs += i.runs.size();
+
+	std::vector<StitchBlock> blocks;
+	{
+		const ScopePhaseTimer timer(stats, ConversionPhase::SCHEDULE);
+		const ScopeMemorySubsystem scope(MemorySubsystem::STITCHES);
+		blocks = ignore_z_order
+			? GroupLayersByColor(layers)
+			: ScheduleLayers(layers, &budget);
+		layers.clear();
 	}
 
 	std::array<uint8_t, 256> colors;
+	if (blocks.size() >= colors.size())
+		throw std::runtime_error("Too many color changes");
+
 	unsigned n_colors = 0;
-	unsigned last_color = 0;
+	for (const auto &i : blocks)
+		colors[n_colors++] = i.color;
+
+	stats.blocks = blocks.size();
+
+	const PesBounds bounds = GetBounds(blocks);
+
+	/* to center the design, pretend the needle starts at the
+	   design's center; the first jump then moves the center to the
+	   origin */
+	const PesPoint origin = center && !bounds.IsEmpty()
+		? bounds.GetCenter()
+		: PesPoint(0, 0);
+
+	SewingEstimate &estimate = stats.sewing;
+	{
+		const ScopePhaseTimer timer(stats, ConversionPhase::ENCODE);
+		PlanStitches(origin, reorder ? &order_options : nullptr,
+			     cost, estimate, blocks);
+	}
+
+	/* the stitches have been planned once; now encode them in
+	   each output format */
+	const ScopeMemorySubsystem pes_scope(MemorySubsystem::PES);
+	const ConstBuffer<uint8_t> color_buffer(&colors.front(), n_colors);
+	for (const char *path : out_paths) {
+		switch (GetOutputFormat(path)) {
+		case OutputFormat::PES:
+			{
+				PesWriter writer(color_buffer,
+						 bounds.GetWidth(),
+						 bounds.GetHeight());
+				PecGraphic graphic(bounds, n_colors);
+				EncodeFile(stats, path, writer, origin, blocks,
+					   thumbnails ? &graphic : nullptr,
+					   [&writer, &graphic, thumbnails](){
+						   writer.End();
+						   if (thumbnails)
+							   writer.AppendGraphic(graphic.GetData());
+						   return writer.GetData();
+					   });
+			}
+			break;
+
+		case OutputFormat::DST:
+			{
+				DstWriter writer(GetDesignName(path).c_str());
+				EncodeFile(stats, path, writer, origin, blocks,
+					   nullptr, [&writer](){
+						   return writer.Finish();
+					   });
+			}
+			break;
+
+		case OutputFormat::EXP:
+			{
+				ExpWriter writer;
+				EncodeFile(stats, path, writer, origin, blocks,
+					   nullptr, [&writer](){
+						   return writer.Finish();
+					   });
+			}
+			break;
+
+		case OutputFormat::JEF:
+			{
+				JefWriter writer(color_buffer,
+						 GetCreationDate());
+				EncodeFile(stats, path, writer, origin, blocks,
+					   nullptr, [&writer](){
+						   return writer.Finish();
+					   });
+			}
+			break;
+		}
+	}
+
+	if (verify)
+		VerifyPes(PesFile(pes_path).GetReader(), origin, blocks);
+
+	if (preview_path != nullptr)
+		WritePreview(PesFile(pes_path).GetReader(), preview_path,
+			     preview_size);
+
+	if (print_estimate)
+		PrintEstimate(estimate, cost, bounds);
 
-	for (const auto &i : paths)
-		if (i.first != last_color)
-			colors[n_colors++] = last_color = i.first;
+	if (print_stats)
+		stats.Print(stderr, json_stats);
 
-	PesWriter writer({&colors.front(), n_colors});
-	SvgToPes(writer, paths);
-	WriteFile(out_path, writer.Finish());
+	if (print_memory_stats)
+		PrintMemoryStats(in_path, json_memory_stats);
 
 	return EXIT_SUCCESS;
 } catch (const std::exception &e) {
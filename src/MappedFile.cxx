@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MappedFile.hxx"
+#include "util/SystemError.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const char *path, bool writable)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		throw FormatErrno("Failed to open %s", path);
+
+	AtScopeExit(fd) { close(fd); };
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		throw FormatErrno("Failed to stat %s", path);
+
+	if (!S_ISREG(st.st_mode))
+		throw std::runtime_error("Not a regular file");
+
+	size = st.st_size;
+	if (size == 0) {
+		/* mmap() rejects empty mappings */
+		data = nullptr;
+		return;
+	}
+
+	data = mmap(nullptr, size,
+		    writable ? PROT_READ|PROT_WRITE : PROT_READ,
+		    MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		throw FormatErrno("Failed to map %s", path);
+
+	madvise(data, size, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() noexcept
+{
+	if (data != nullptr)
+		munmap(data, size);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * A memory mapping of a whole regular file.
+ */
+class MappedFile {
+	void *data;
+	size_t size;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param writable map copy-on-write, i.e. the caller may
+	 * modify the contents without affecting the file
+	 */
+	explicit MappedFile(const char *path, bool writable=false);
+
+	~MappedFile() noexcept;
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	void *GetData() const {
+		return data;
+	}
+
+	size_t GetSize() const {
+		return size;
+	}
+};
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "MemoryStats.hxx"
+
+#ifdef ENABLE_MEMORY_STATS
+
+#include <atomic>
+#include <new>
+
+#include <stdlib.h>
+
+namespace {
+
+/**
+ * Prepended to each block; its size keeps the alignment which
+ * malloc() guarantees.
+ */
+struct alignas(16) AllocationHeader {
+	size_t size;
+	MemorySubsystem subsystem;
+	unsigned phase;
+};
+
+/**
+ * The index for allocations outside of all phases.
+ */
+constexpr unsigned NO_PHASE = unsigned(ConversionPhase::N);
+
+struct MemoryCounters {
+	std::atomic<size_t> allocations{0}, bytes{0};
+	std::atomic<size_t> live{0}, peak{0};
+
+	void Allocate(size_t size) noexcept {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		bytes.fetch_add(size, std::memory_order_relaxed);
+
+		const size_t new_live =
+			live.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t old_peak = peak.load(std::memory_order_relaxed);
+		while (new_live > old_peak &&
+		       !peak.compare_exchange_weak(old_peak, new_live,
+						   std::memory_order_relaxed)) {}
+	}
+
+	void Free(size_t size) noexcept {
+		live.fetch_sub(size, std::memory_order_relaxed);
+	}
+};
+
+MemoryCounters total_counters;
+MemoryCounters subsystem_counters[size_t(MemorySubsystem::N)];
+
+/**
+ * Only "allocations", "bytes" and "peak" are used; the peak is the
+ * total heap size (not only blocks allocated in this phase) while the
+ * phase is active.
+ */
+MemoryCounters phase_counters[NO_PHASE + 1];
+
+std::atomic<unsigned> current_phase{NO_PHASE};
+
+thread_local MemorySubsystem current_subsystem = MemorySubsystem::OTHER;
+
+void
+UpdatePhasePeak() noexcept
+{
+	auto &phase =
+		phase_counters[current_phase.load(std::memory_order_relaxed)];
+	const size_t live = total_counters.live.load(std::memory_order_relaxed);
+	size_t old_peak = phase.peak.load(std::memory_order_relaxed);
+	while (live > old_peak &&
+	       !phase.peak.compare_exchange_weak(old_peak, live,
+						 std::memory_order_relaxed)) {}
+}
+
+void
+Account(const AllocationHeader &h) noexcept
+{
+	total_counters.Allocate(h.size);
+	subsystem_counters[size_t(h.subsystem)].Allocate(h.size);
+
+	auto &phase = phase_counters[h.phase];
+	phase.allocations.fetch_add(1, std::memory_order_relaxed);
+	phase.bytes.fetch_add(h.size, std::memory_order_relaxed);
+	UpdatePhasePeak();
+}
+
+void
+Unaccount(const AllocationHeader &h) noexcept
+{
+	total_counters.Free(h.size);
+	subsystem_counters[size_t(h.subsystem)].Free(h.size);
+}
+
+void *
+AccountedMalloc(size_t size, MemorySubsystem subsystem) noexcept
+{
+	auto *h = (AllocationHeader *)malloc(sizeof(AllocationHeader) + size);
+	if (h == nullptr)
+		return nullptr;
+
+	h->size = size;
+	h->subsystem = subsystem;
+	h->phase = current_phase.load(std::memory_order_relaxed);
+	Account(*h);
+	return h + 1;
+}
+
+void
+AccountedFree(void *p) noexcept
+{
+	if (p == nullptr)
+		return;
+
+	auto *h = (AllocationHeader *)p - 1;
+	Unaccount(*h);
+	free(h);
+}
+
+void *
+AccountedRealloc(void *p, size_t size, MemorySubsystem subsystem) noexcept
+{
+	if (p == nullptr)
+		return AccountedMalloc(size, subsystem);
+
+	auto *h = (AllocationHeader *)p - 1;
+	const AllocationHeader old = *h;
+
+	h = (AllocationHeader *)realloc(h, sizeof(*h) + size);
+	if (h == nullptr)
+		return nullptr;
+
+	Unaccount(old);
+	h->size = size;
+	h->phase = current_phase.load(std::memory_order_relaxed);
+	Account(*h);
+	return h + 1;
+}
+
+void *
+NewOrThrow(size_t size)
+{
+	void *p = AccountedMalloc(size, current_subsystem);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+} // anonymous namespace
+
+void *
+operator new(size_t size)
+{
+	return NewOrThrow(size);
+}
+
+void *
+operator new[](size_t size)
+{
+	return NewOrThrow(size);
+}
+
+void *
+operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return AccountedMalloc(size, current_subsystem);
+}
+
+void *
+operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return AccountedMalloc(size, current_subsystem);
+}
+
+void
+operator delete(void *p) noexcept
+{
+	AccountedFree(p);
+}
+
+void
+operator delete[](void *p) noexcept
+{
+	AccountedFree(p);
+}
+
+void
+operator delete(void *p, size_t) noexcept
+{
+	AccountedFree(p);
+}
+
+void
+operator delete[](void *p, size_t) noexcept
+{
+	AccountedFree(p);
+}
+
+void
+operator delete(void *p, const std::nothrow_t &) noexcept
+{
+	AccountedFree(p);
+}
+
+void
+operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+	AccountedFree(p);
+}
+
+ScopeMemorySubsystem::ScopeMemorySubsystem(MemorySubsystem subsystem) noexcept
+	:previous(current_subsystem)
+{
+	current_subsystem = subsystem;
+}
+
+ScopeMemorySubsystem::~ScopeMemorySubsystem() noexcept
+{
+	current_subsystem = previous;
+}
+
+ScopeMemoryPhase::ScopeMemoryPhase(ConversionPhase phase) noexcept
+	:previous(current_phase.exchange(unsigned(phase)))
+{
+	UpdatePhasePeak();
+}
+
+ScopeMemoryPhase::~ScopeMemoryPhase() noexcept
+{
+	current_phase = previous;
+}
+
+void *
+XmlMalloc(size_t size) noexcept
+{
+	return AccountedMalloc(size, MemorySubsystem::XML);
+}
+
+void *
+XmlRealloc(void *p, size_t size) noexcept
+{
+	return AccountedRealloc(p, size, MemorySubsystem::XML);
+}
+
+void
+XmlFree(void *p) noexcept
+{
+	AccountedFree(p);
+}
+
+static constexpr const char *subsystem_names[] = {
+	"other",
+	"xml",
+	"styles",
+	"paths",
+	"stitches",
+	"pes",
+};
+
+static_assert(sizeof(subsystem_names) / sizeof(subsystem_names[0]) ==
+	      size_t(MemorySubsystem::N), "");
+
+static const char *
+GetPhaseIndexName(unsigned i)
+{
+	return i < NO_PHASE
+		? GetPhaseName(ConversionPhase(i))
+		: "other";
+}
+
+void
+PrintMemoryStats(FILE *file, bool json, size_t input_bytes)
+{
+	const size_t peak = total_counters.peak.load();
+	const double per_mb = input_bytes > 0
+		? peak / (input_bytes / 1048576.)
+		: 0;
+
+	if (json) {
+		fprintf(file, "{\"peak_bytes\":%zu,\"allocations\":%zu,"
+			"\"allocated_bytes\":%zu,\"peak_bytes_per_input_mb\":%.0f,"
+			"\"subsystems\":{",
+			peak, total_counters.allocations.load(),
+			total_counters.bytes.load(), per_mb);
+
+		for (size_t i = 0; i < size_t(MemorySubsystem::N); ++i) {
+			const auto &c = subsystem_counters[i];
+			fprintf(file, "%s\"%s\":{\"allocations\":%zu,"
+				"\"allocated_bytes\":%zu,\"peak_bytes\":%zu}",
+				i > 0 ? "," : "", subsystem_names[i],
+				c.allocations.load(), c.bytes.load(),
+				c.peak.load());
+		}
+
+		fputs("},\"phases\":{", file);
+		for (unsigned i = 0; i <= NO_PHASE; ++i) {
+			const auto &c = phase_counters[i];
+			fprintf(file, "%s\"%s\":{\"allocations\":%zu,"
+				"\"allocated_bytes\":%zu,\"peak_bytes\":%zu}",
+				i > 0 ? "," : "", GetPhaseIndexName(i),
+				c.allocations.load(), c.bytes.load(),
+				c.peak.load());
+		}
+
+		fputs("}}\n", file);
+	} else {
+		fprintf(file, "peak_bytes = %zu\n"
+			"allocations = %zu\n"
+			"allocated_bytes = %zu\n"
+			"peak_bytes_per_input_mb = %.0f\n",
+			peak, total_counters.allocations.load(),
+			total_counters.bytes.load(), per_mb);
+
+		for (size_t i = 0; i < size_t(MemorySubsystem::N); ++i) {
+			const auto &c = subsystem_counters[i];
+			fprintf(file, "%s.allocations = %zu\n"
+				"%s.allocated_bytes = %zu\n"
+				"%s.peak_bytes = %zu\n",
+				subsystem_names[i], c.allocations.load(),
+				subsystem_names[i], c.bytes.load(),
+				subsystem_names[i], c.peak.load());
+		}
+
+		for (unsigned i = 0; i <= NO_PHASE; ++i) {
+			const auto &c = phase_counters[i];
+			const char *name = GetPhaseIndexName(i);
+			fprintf(file, "%s.allocations = %zu\n"
+				"%s.allocated_bytes = %zu\n"
+				"%s.peak_bytes = %zu\n",
+				name, c.allocations.load(),
+				name, c.bytes.load(),
+				name, c.peak.load());
+		}
+	}
+}
+
+#endif
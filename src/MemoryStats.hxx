@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "ConversionPhase.hxx"
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Optional accounting of heap allocations by subsystem and by
+ * conversion phase.  It is compiled in with -DENABLE_MEMORY_STATS
+ * (Meson option "memory_stats"), which replaces the global operator
+ * new and Expat's allocator with versions that prepend a small header
+ * to each block.
+ */
+
+/**
+ * The subsystem which an allocation is attributed to.
+ */
+enum class MemorySubsystem : unsigned {
+	OTHER,
+
+	/**
+	 * Expat's internal buffers.
+	 */
+	XML,
+
+	/**
+	 * CSS style sheets, the style and transform caches.
+	 */
+	STYLES,
+
+	/**
+	 * Tessellated shapes (#SvgPath vertices).
+	 */
+	PATHS,
+
+	/**
+	 * Stitch runs, layers, color blocks and run ordering.
+	 */
+	STITCHES,
+
+	/**
+	 * Encoded PES data (#PesWriter buffers).
+	 */
+	PES,
+
+	N
+};
+
+#ifdef ENABLE_MEMORY_STATS
+
+/**
+ * Attribute allocations of the current thread to the given
+ * subsystem until this object is destructed.
+ */
+class ScopeMemorySubsystem {
+	const MemorySubsystem previous;
+
+public:
+	explicit ScopeMemorySubsystem(MemorySubsystem subsystem) noexcept;
+	~ScopeMemorySubsystem() noexcept;
+
+	ScopeMemorySubsystem(const ScopeMemorySubsystem &) = delete;
+	ScopeMemorySubsystem &operator=(const ScopeMemorySubsystem &) = delete;
+};
+
+/**
+ * Attribute allocations to the given phase (from all threads) until
+ * this object is destructed.
+ */
+class ScopeMemoryPhase {
+	const unsigned previous;
+
+public:
+	explicit ScopeMemoryPhase(ConversionPhase phase) noexcept;
+	~ScopeMemoryPhase() noexcept;
+
+	ScopeMemoryPhase(const ScopeMemoryPhase &) = delete;
+	ScopeMemoryPhase &operator=(const ScopeMemoryPhase &) = delete;
+};
+
+/*
+ * An allocator for Expat's XML_Memory_Handling_Suite, attributing all
+ * blocks to #MemorySubsystem::XML.
+ */
+void *
+XmlMalloc(size_t size) noexcept;
+
+void *
+XmlRealloc(void *p, size_t size) noexcept;
+
+void
+XmlFree(void *p) noexcept;
+
+/**
+ * Print the number of allocations and the peak number of bytes by
+ * subsystem and by phase.
+ *
+ * @param input_bytes the size of the input file, for calculating
+ * the peak heap size per input megabyte
+ */
+void
+PrintMemoryStats(FILE *file, bool json, size_t input_bytes);
+
+#else
+
+class ScopeMemorySubsystem {
+public:
+	explicit ScopeMemorySubsystem(MemorySubsystem) noexcept {}
+};
+
+class ScopeMemoryPhase {
+public:
+	explicit ScopeMemoryPhase(ConversionPhase) noexcept {}
+};
+
+#endif
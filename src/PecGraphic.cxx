@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PecGraphic.hxx"
+#include "PesBounds.hxx"
+
+#include <algorithm>
+
+#include <stdlib.h>
+
+/**
+ * The area inside the frame which the design is scaled to.
+ */
+static constexpr int PEC_GRAPHIC_LEFT = 4, PEC_GRAPHIC_RIGHT = 43;
+static constexpr int PEC_GRAPHIC_TOP = 3, PEC_GRAPHIC_BOTTOM = 34;
+
+PecThumbnail::PecThumbnail() noexcept
+{
+	bits.fill(0);
+
+	/* a frame with beveled corners, like the thumbnails of
+	   Brother's software */
+	constexpr unsigned right = PEC_GRAPHIC_WIDTH - 1;
+	constexpr unsigned bottom = PEC_GRAPHIC_HEIGHT - 1;
+	DrawLine(2, 0, right - 2, 0);
+	DrawLine(2, bottom, right - 2, bottom);
+	DrawLine(0, 2, 0, bottom - 2);
+	DrawLine(right, 2, right, bottom - 2);
+	SetPixel(1, 1);
+	SetPixel(right - 1, 1);
+	SetPixel(1, bottom - 1);
+	SetPixel(right - 1, bottom - 1);
+}
+
+void
+PecThumbnail::DrawLine(int x0, int y0, int x1, int y1) noexcept
+{
+	const int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+	const int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+	int error = dx + dy;
+
+	while (true) {
+		SetPixel(x0, y0);
+		if (x0 == x1 && y0 == y1)
+			break;
+
+		const int e2 = 2 * error;
+		if (e2 >= dy) {
+			error += dy;
+			x0 += sx;
+		}
+
+		if (e2 <= dx) {
+			error += dx;
+			y0 += sy;
+		}
+	}
+}
+
+PecGraphic::PecGraphic(const PesBounds &bounds, unsigned n_blocks)
+	:thumbnails(1 + n_blocks), block(&thumbnails.front())
+{
+	constexpr int64_t max_width = PEC_GRAPHIC_RIGHT - PEC_GRAPHIC_LEFT;
+	constexpr int64_t max_height = PEC_GRAPHIC_BOTTOM - PEC_GRAPHIC_TOP;
+
+	if (bounds.IsEmpty()) {
+		min_x = min_y = 0;
+		scale = 0;
+	} else {
+		min_x = bounds.min_x;
+		min_y = bounds.min_y;
+
+		/* fit the design into the frame, keeping the aspect
+		   ratio */
+		const int64_t width = bounds.GetWidth();
+		const int64_t height = bounds.GetHeight();
+		scale = INT64_MAX;
+		if (width > 0)
+			scale = (max_width << 16) / width;
+		if (height > 0)
+			scale = std::min(scale, (max_height << 16) / height);
+		if (scale == INT64_MAX)
+			/* a single point */
+			scale = 0;
+	}
+
+	/* center it */
+	offset_x = PEC_GRAPHIC_LEFT +
+		int(max_width - ((bounds.GetWidth() * scale) >> 16)) / 2;
+	offset_y = PEC_GRAPHIC_TOP +
+		int(max_height - ((bounds.GetHeight() * scale) >> 16)) / 2;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "PesPoint.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <array>
+#include <vector>
+
+#include <stdint.h>
+
+struct PesBounds;
+
+static constexpr unsigned PEC_GRAPHIC_WIDTH = 48, PEC_GRAPHIC_HEIGHT = 38;
+
+/**
+ * One monochrome thumbnail of the PEC graphic section: one bit per
+ * pixel, 8 pixels per byte, the leftmost pixel in the least
+ * significant bit.
+ */
+struct PecThumbnail {
+	static constexpr unsigned STRIDE = PEC_GRAPHIC_WIDTH / 8;
+
+	std::array<uint8_t, STRIDE * PEC_GRAPHIC_HEIGHT> bits;
+
+	/**
+	 * Initialize with an empty frame.
+	 */
+	PecThumbnail() noexcept;
+
+	void SetPixel(unsigned x, unsigned y) noexcept {
+		if (x < PEC_GRAPHIC_WIDTH && y < PEC_GRAPHIC_HEIGHT)
+			bits[y * STRIDE + x / 8] |= 1 << (x % 8);
+	}
+
+	/**
+	 * Draw a line with the Bresenham algorithm, including both
+	 * end points.
+	 */
+	void DrawLine(int x0, int y0, int x1, int y1) noexcept;
+};
+
+static_assert(sizeof(PecThumbnail) == 228, "Wrong PEC thumbnail size");
+
+/**
+ * Builds the PEC graphic section while the stitches are encoded: a
+ * thumbnail of the whole design followed by one per color block.
+ * Needle positions are scaled from the design bounds to the
+ * thumbnail, and each stitch is drawn as a 1-bit line.
+ */
+class PecGraphic {
+	/**
+	 * The first one shows the whole design.
+	 */
+	std::vector<PecThumbnail> thumbnails;
+
+	PecThumbnail *block;
+
+	int min_x, min_y;
+
+	/**
+	 * The pixel position of #min_x, #min_y.
+	 */
+	int offset_x, offset_y;
+
+	/**
+	 * Pixels per PES unit [16.16 fixed point].
+	 */
+	int64_t scale;
+
+	/**
+	 * The pixel position of the needle.
+	 */
+	int cursor_x = 0, cursor_y = 0;
+
+public:
+	/**
+	 * @param bounds the bounds of all needle positions which
+	 * will be passed to MoveTo() and LineTo()
+	 * @param n_blocks the number of color blocks
+	 */
+	PecGraphic(const PesBounds &bounds, unsigned n_blocks);
+
+	/**
+	 * Draw the following stitches into the thumbnail of the
+	 * given color block (in addition to the whole design).
+	 */
+	void SetBlock(unsigned i) noexcept {
+		block = &thumbnails[1 + i];
+	}
+
+	/**
+	 * Move the needle without sewing.
+	 */
+	void MoveTo(PesPoint p) noexcept {
+		cursor_x = MapX(p.x);
+		cursor_y = MapY(p.y);
+	}
+
+	/**
+	 * Sew a stitch from the current needle position.
+	 */
+	void LineTo(PesPoint p) noexcept {
+		const int x = MapX(p.x), y = MapY(p.y);
+
+		if (x == cursor_x && y == cursor_y) {
+			/* most stitches are shorter than one pixel */
+			thumbnails.front().SetPixel(x, y);
+			block->SetPixel(x, y);
+		} else {
+			thumbnails.front().DrawLine(cursor_x, cursor_y, x, y);
+			block->DrawLine(cursor_x, cursor_y, x, y);
+			cursor_x = x;
+			cursor_y = y;
+		}
+	}
+
+	/**
+	 * Return the whole graphic section.
+	 */
+	ConstBuffer<uint8_t> GetData() const noexcept {
+		return {thumbnails.front().bits.data(),
+			thumbnails.size() * sizeof(PecThumbnail)};
+	}
+
+private:
+	int MapX(int x) const noexcept {
+		return offset_x + int(((x - min_x) * scale) >> 16);
+	}
+
+	int MapY(int y) const noexcept {
+		return offset_y + int(((y - min_y) * scale) >> 16);
+	}
+};
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PesBounds.hxx"
+
+void
+PesBounds::Extend(ConstBuffer<PesPoint> points) noexcept
+{
+	/* local accumulators without branches, so the compiler can
+	   turn this loop into a SIMD min/max reduction (e.g. GCC with
+	   -O3) */
+	int _min_x = min_x, _min_y = min_y, _max_x = max_x, _max_y = max_y;
+
+	for (const auto p : points) {
+		_min_x = std::min(_min_x, p.x);
+		_min_y = std::min(_min_y, p.y);
+		_max_x = std::max(_max_x, p.x);
+		_max_y = std::max(_max_y, p.y);
+	}
+
+	min_x = _min_x;
+	min_y = _min_y;
+	max_x = _max_x;
+	max_y = _max_y;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "PesPoint.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Compiler.h"
+
+#include <algorithm>
+
+#include <limits.h>
+
+/**
+ * An axis-aligned bounding box in PES coordinates.  The maximum is
+ * inclusive.
+ */
+struct PesBounds {
+	int min_x = INT_MAX, min_y = INT_MAX;
+	int max_x = INT_MIN, max_y = INT_MIN;
+
+	bool IsEmpty() const {
+		return min_x > max_x;
+	}
+
+	unsigned GetWidth() const {
+		return IsEmpty() ? 0 : max_x - min_x;
+	}
+
+	unsigned GetHeight() const {
+		return IsEmpty() ? 0 : max_y - min_y;
+	}
+
+	PesPoint GetCenter() const {
+		return {min_x + (max_x - min_x) / 2,
+			min_y + (max_y - min_y) / 2};
+	}
+
+	void Extend(PesPoint p) {
+		min_x = std::min(min_x, p.x);
+		min_y = std::min(min_y, p.y);
+		max_x = std::max(max_x, p.x);
+		max_y = std::max(max_y, p.y);
+	}
+
+	void Extend(const PesBounds &other) {
+		min_x = std::min(min_x, other.min_x);
+		min_y = std::min(min_y, other.min_y);
+		max_x = std::max(max_x, other.max_x);
+		max_y = std::max(max_y, other.max_y);
+	}
+
+	/**
+	 * Extend by all the given points.
+	 */
+	void Extend(ConstBuffer<PesPoint> points) noexcept;
+
+	bool OverlapsY(const PesBounds &other) const {
+		return min_y <= other.max_y && other.min_y <= max_y;
+	}
+};
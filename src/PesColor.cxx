@@ -121,3 +121,13 @@ NearestPesColor(Color c) noexcept
 
 	return best;
 }
+
+Color
+GetPesColor(unsigned code) noexcept
+{
+	if (code >= sizeof(pes_colors) / sizeof(pes_colors[0]))
+		/* unknown; black is the most likely choice */
+		return {0, 0, 0};
+
+	return pes_colors[code];
+}
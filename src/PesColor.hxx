@@ -28,3 +28,10 @@ struct Color;
 gcc_const
 unsigned
 NearestPesColor(Color c) noexcept;
+
+/**
+ * Look up the RGB value of a PES color code.
+ */
+gcc_const
+Color
+GetPesColor(unsigned code) noexcept;
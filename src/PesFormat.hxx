@@ -22,6 +22,8 @@
 
 #include <array>
 
+#include <stddef.h>
+
 struct PesHeader {
 	char id[4]{'#', 'P', 'E', 'S'};
 	char number[4]{'0', '0', '0', '1'};
@@ -41,8 +43,15 @@ struct PecHeader {
 	std::array<uint8_t, 256> colors;
 	std::array<uint8_t, 207> unknown2;
 	std::array<uint8_t, 2> unknown3;
-	gcc_packed uint32_t graphic_offset = ToLE32(0);
-	uint16_t unknown4 = 0;
+
+	/**
+	 * The lower 24 bits are the offset of the graphic section
+	 * relative to #unknown3, where the stitch section begins; the
+	 * upper 8 bits are always 0x31.
+	 */
+	gcc_packed uint32_t graphic_offset = ToLE32(MakeGraphicOffset(0));
+
+	uint16_t unknown4 = ToLE16(0xf0ff);
 	uint16_t width = ToLE16(0), height = ToLE16(0);
 	std::array<uint8_t, 8> unknown5;
 
@@ -56,6 +65,24 @@ struct PecHeader {
 		unknown3.fill(0);
 		unknown5.fill(0);
 	}
+
+	static constexpr uint32_t MakeGraphicOffset(uint32_t offset) {
+		return 0x31000000 | offset;
+	}
 };
 
 static_assert(sizeof(PecHeader) == 532, "Wrong PEC header size");
+
+/**
+ * The offset of the stitch section in the PEC header, which
+ * PecHeader::graphic_offset is relative to.
+ */
+static constexpr size_t PEC_STITCH_SECTION_OFFSET = 512;
+
+/**
+ * The largest value of PecHeader::graphic_offset (24 bits).
+ */
+static constexpr size_t PEC_MAX_GRAPHIC_OFFSET = 0xffffff;
+
+static_assert(offsetof(PecHeader, unknown3) == PEC_STITCH_SECTION_OFFSET,
+	      "Wrong PEC stitch section offset");
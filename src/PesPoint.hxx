@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016-2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "SvgData.hxx"
+
+#include <math.h>
+
+/**
+ * The number of PES units (1/10 mm) per SVG user unit (90 DPI).
+ */
+static constexpr double PES_PER_SVG = 25.4 * 10 / 90;
+
+/**
+ * Convert millimeters to SVG user units.
+ */
+inline constexpr double
+MillimetersToSvg(double mm)
+{
+	return mm * 10 / PES_PER_SVG;
+}
+
+/**
+ * A point in a PES file.
+ */
+struct PesPoint {
+	int x, y;
+
+	PesPoint() = default;
+	constexpr PesPoint(int _x, int _y)
+		:x(_x), y(_y) {}
+
+	/**
+	 * Import from a SVG point, scaling to PES coordinates.
+	 */
+#if defined(__GNUC__) && !defined(__clang__)
+	constexpr
+#endif
+	PesPoint(SvgPoint src):x(FromSvg(src.x)), y(FromSvg(src.y)) {}
+
+	constexpr bool operator==(PesPoint other) const {
+		return x == other.x && y == other.y;
+	}
+
+	constexpr bool operator!=(PesPoint other) const {
+		return !(*this == other);
+	}
+
+	constexpr PesPoint operator+(PesPoint other) const {
+		return {x + other.x, y + other.y};
+	}
+
+	constexpr PesPoint operator-(PesPoint other) const {
+		return {x - other.x, y - other.y};
+	}
+
+	PesPoint &operator+=(PesPoint other) {
+		x += other.x;
+		y += other.y;
+		return *this;
+	}
+
+private:
+#if defined(__GNUC__) && !defined(__clang__)
+	/* lround() is a constexpr built-in in GCC */
+	constexpr
+#endif
+	static int FromSvg(double value) {
+		return lround(value * PES_PER_SVG);
+	}
+};
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PesReader.hxx"
+
+#include <stdexcept>
+
+#include <string.h>
+
+namespace {
+
+/**
+ * What a byte means at the start of a coordinate.
+ */
+enum class PesByteKind : uint8_t {
+	/**
+	 * A 7 bit coordinate (0x00..0x7f).
+	 */
+	SMALL,
+
+	/**
+	 * The first byte of a 12 bit coordinate with flags
+	 * (0x80..0xbf).
+	 */
+	BIG,
+
+	/**
+	 * A color change (0xfe 0xb0 COLOR).
+	 */
+	COLOR_CHANGE,
+
+	/**
+	 * The end mark (0xff 0x00).
+	 */
+	END,
+
+	INVALID,
+};
+
+struct PesByteInfo {
+	PesByteKind kind;
+
+	/**
+	 * For #SMALL: the coordinate; for #BIG: the flags.
+	 */
+	int8_t value;
+};
+
+struct PesByteTable {
+	PesByteInfo bytes[256];
+
+	constexpr PesByteTable():bytes() {
+		for (unsigned b = 0; b < 256; ++b) {
+			if (b < 0x80)
+				bytes[b] = {PesByteKind::SMALL,
+					    int8_t(b & 0x40 ? int(b) - 0x80 : int(b))};
+			else if (b < 0xc0)
+				bytes[b] = {PesByteKind::BIG, int8_t(b & 0x30)};
+			else if (b == 0xfe)
+				bytes[b] = {PesByteKind::COLOR_CHANGE, 0};
+			else if (b == 0xff)
+				bytes[b] = {PesByteKind::END, 0};
+			else
+				bytes[b] = {PesByteKind::INVALID, 0};
+		}
+	}
+};
+
+constexpr PesByteTable pes_byte_table;
+
+constexpr uint8_t PES_FLAG_JUMP = 0x10, PES_FLAG_TRIM = 0x20;
+
+gcc_noreturn
+void
+ThrowPrematureEnd()
+{
+	throw std::runtime_error("Premature end of PES stitch data");
+}
+
+/**
+ * Decode one coordinate and advance the pointer.
+ *
+ * @param flags the flags of "big" coordinates are added here
+ */
+inline int
+DecodeCoordinate(const uint8_t *&p, const uint8_t *end, uint8_t &flags)
+{
+	if (p == end)
+		ThrowPrematureEnd();
+
+	const auto info = pes_byte_table.bytes[*p];
+	if (gcc_likely(info.kind == PesByteKind::SMALL)) {
+		++p;
+		return info.value;
+	}
+
+	if (gcc_unlikely(info.kind != PesByteKind::BIG))
+		throw std::runtime_error("Malformed PES coordinate");
+
+	if (end - p < 2)
+		ThrowPrematureEnd();
+
+	flags |= info.value;
+	int value = ((p[0] & 0xf) << 8) | p[1];
+	p += 2;
+
+	if (value & 0x800)
+		value -= 0x1000;
+	return value;
+}
+
+/**
+ * Decode the coordinates of a stitch, jump or trim command and
+ * advance the pointer.
+ */
+inline PesStitch
+DecodeStitch(const uint8_t *&p, const uint8_t *end, PesPoint &position)
+{
+	uint8_t flags = 0;
+	position.x += DecodeCoordinate(p, end, flags);
+	position.y += DecodeCoordinate(p, end, flags);
+
+	PesStitch::Type type = PesStitch::Type::STITCH;
+	if (flags & PES_FLAG_TRIM)
+		type = PesStitch::Type::TRIM;
+	else if (flags & PES_FLAG_JUMP)
+		type = PesStitch::Type::JUMP;
+
+	return {type, 0, position};
+}
+
+/**
+ * The size of an encoded coordinate starting with the given byte.
+ */
+constexpr size_t
+GetCoordinateSize(uint8_t b)
+{
+	return pes_byte_table.bytes[b].kind == PesByteKind::BIG ? 2 : 1;
+}
+
+}
+
+PesReader::PesReader(ConstBuffer<uint8_t> data)
+{
+	if (data.size < sizeof(pes_header))
+		throw std::runtime_error("PES file too short");
+
+	memcpy(&pes_header, data.data, sizeof(pes_header));
+
+	const PesHeader expected{};
+	if (memcmp(pes_header.id, expected.id, sizeof(expected.id)) != 0)
+		throw std::runtime_error("Malformed PES id");
+
+	const size_t pec_offset = FromLE32(pes_header.pec_offset);
+	if (pec_offset < sizeof(pes_header) ||
+	    pec_offset > data.size ||
+	    data.size - pec_offset < sizeof(pec_header))
+		throw std::runtime_error("Malformed PEC offset");
+
+	memcpy(&pec_header, data.data + pec_offset, sizeof(pec_header));
+
+	const size_t stitch_offset = pec_offset + sizeof(pec_header);
+	stitch_data = {data.data + stitch_offset, data.size - stitch_offset};
+
+	const size_t graphic_offset =
+		FromLE32(pec_header.graphic_offset) & PEC_MAX_GRAPHIC_OFFSET;
+	if (graphic_offset > 0) {
+		const size_t offset = pec_offset + PEC_STITCH_SECTION_OFFSET +
+			graphic_offset;
+		if (offset < stitch_offset || offset > data.size)
+			throw std::runtime_error("Malformed PEC graphic offset");
+
+		graphic = {data.data + offset, data.size - offset};
+	}
+}
+
+void
+PesReader::Decode(std::vector<PesStitch> &dest) const
+{
+	const uint8_t *p = stitch_data.begin(), *const end = stitch_data.end();
+
+	/* most commands are "small" stitches of two bytes */
+	dest.reserve(dest.size() + stitch_data.size / 2);
+
+	PesPoint position(0, 0);
+
+	while (true) {
+		if (p == end)
+			ThrowPrematureEnd();
+
+		switch (pes_byte_table.bytes[*p].kind) {
+		case PesByteKind::SMALL:
+		case PesByteKind::BIG:
+			dest.push_back(DecodeStitch(p, end, position));
+			break;
+
+		case PesByteKind::COLOR_CHANGE:
+			if (end - p < 3)
+				ThrowPrematureEnd();
+
+			if (p[1] != 0xb0)
+				throw std::runtime_error("Unknown 0xfe command");
+
+			dest.push_back({PesStitch::Type::COLOR_CHANGE, p[2], position});
+			p += 3;
+			break;
+
+		case PesByteKind::END:
+			if (end - p < 2)
+				ThrowPrematureEnd();
+
+			if (p[1] != 0x00)
+				throw std::runtime_error("Unknown 0xff command");
+
+			return;
+
+		case PesByteKind::INVALID:
+			throw std::runtime_error("Unknown PES command");
+		}
+	}
+}
+
+size_t
+DecodePesStitches(ConstBuffer<uint8_t> src, PesPoint &position,
+		  std::vector<PesStitch> &dest)
+{
+	const uint8_t *p = src.begin(), *const end = src.end();
+
+	while (p != end) {
+		const auto kind = pes_byte_table.bytes[*p].kind;
+		if (kind != PesByteKind::SMALL && kind != PesByteKind::BIG)
+			throw std::runtime_error("Unexpected PES command");
+
+		/* stop at a command which is not complete yet */
+		const size_t x_size = GetCoordinateSize(*p);
+		if (size_t(end - p) <= x_size ||
+		    size_t(end - p) < x_size + GetCoordinateSize(p[x_size]))
+			break;
+
+		dest.push_back(DecodeStitch(p, end, position));
+	}
+
+	return p - src.begin();
+}
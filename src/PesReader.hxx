@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "PesFormat.hxx"
+#include "PesPoint.hxx"
+#include "MappedFile.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * One decoded command of the PEC stitch stream.
+ */
+struct PesStitch {
+	enum class Type : uint8_t {
+		STITCH,
+		JUMP,
+		TRIM,
+		COLOR_CHANGE,
+	};
+
+	Type type;
+
+	/**
+	 * The new color index (only for #COLOR_CHANGE).
+	 */
+	uint8_t color;
+
+	/**
+	 * The needle position after this command, relative to the
+	 * position where sewing started.
+	 */
+	PesPoint position;
+};
+
+/**
+ * Parser for PES data in memory.  The constructor validates the
+ * headers; Decode() converts the stitch stream to absolute
+ * coordinates.
+ */
+class PesReader {
+	PesHeader pes_header;
+	PecHeader pec_header{0, 0};
+
+	ConstBuffer<uint8_t> stitch_data;
+
+	ConstBuffer<uint8_t> graphic = nullptr;
+
+public:
+	/**
+	 * Throws on error.
+	 *
+	 * @param data the PES file contents; they are not copied and
+	 * must remain valid as long as this object is used
+	 */
+	explicit PesReader(ConstBuffer<uint8_t> data);
+
+	unsigned GetWidth() const {
+		return FromLE16(pec_header.width);
+	}
+
+	unsigned GetHeight() const {
+		return FromLE16(pec_header.height);
+	}
+
+	ConstBuffer<uint8_t> GetColors() const {
+		return {pec_header.colors.data(), pec_header.n_colors};
+	}
+
+	/**
+	 * The raw stitch stream, up to the end of the file.
+	 */
+	ConstBuffer<uint8_t> GetStitchData() const {
+		return stitch_data;
+	}
+
+	/**
+	 * The PEC graphic section, up to the end of the file; empty
+	 * if the file has none.
+	 */
+	ConstBuffer<uint8_t> GetGraphic() const {
+		return graphic;
+	}
+
+	/**
+	 * Decode the stitch stream up to the end mark and append the
+	 * commands to #dest.  Throws on error.
+	 */
+	void Decode(std::vector<PesStitch> &dest) const;
+};
+
+/**
+ * Decode a fragment of a stitch stream which contains only
+ * stitches, jumps and trims (no color changes and no end mark), as
+ * written by a #PesWriter without headers.  A command which is
+ * incomplete at the end of the buffer is not consumed, so the
+ * fragment can be fed in chunks.  Throws on error.
+ *
+ * @param position the needle position before the first command; it
+ * is updated
+ * @return the number of bytes consumed
+ */
+size_t
+DecodePesStitches(ConstBuffer<uint8_t> src, PesPoint &position,
+		  std::vector<PesStitch> &dest);
+
+/**
+ * A #PesReader on a memory-mapped file.
+ */
+class PesFile {
+	MappedFile file;
+	PesReader reader;
+
+public:
+	/**
+	 * Throws on error.
+	 */
+	explicit PesFile(const char *path)
+		:file(path),
+		 reader({(const uint8_t *)file.GetData(), file.GetSize()}) {}
+
+	const PesReader &GetReader() const {
+		return reader;
+	}
+};
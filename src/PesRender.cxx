@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PesRender.hxx"
+#include "PesReader.hxx"
+#include "PesBounds.hxx"
+#include "PesColor.hxx"
+#include "Color.hxx"
+#include "util/SystemError.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+#include <stdio.h>
+
+namespace {
+
+/**
+ * The number of fractional bits of pixel coordinates; with 8 bits,
+ * the fraction is the anti-aliasing coverage.
+ */
+constexpr unsigned FRACTION_BITS = 8;
+constexpr int ONE = 1 << FRACTION_BITS;
+constexpr int HALF = ONE / 2;
+
+/**
+ * The number of pixel rows rendered by a thread at a time.
+ */
+constexpr unsigned BAND_HEIGHT = 64;
+
+/**
+ * A stitch in fixed point pixel coordinates.
+ */
+struct Segment {
+	int x0, y0, x1, y1;
+	Color color;
+};
+
+/**
+ * Renders segments into the rows [#y_begin, #y_end) of an image.
+ */
+class BandRenderer {
+	RgbImage &image;
+	const int y_begin, y_end;
+
+public:
+	BandRenderer(RgbImage &_image, int _y_begin, int _y_end) noexcept
+		:image(_image), y_begin(_y_begin), y_end(_y_end) {}
+
+	void Draw(const Segment &s) noexcept;
+
+private:
+	/**
+	 * Blend a pixel with the given coverage (0..256).
+	 */
+	void Plot(int x, int y, Color c, unsigned alpha) noexcept {
+		if (y < y_begin || y >= y_end || x < 0 ||
+		    x >= int(image.width))
+			return;
+
+		uint8_t *p = &image.pixels[(size_t(y) * image.width + x) * 3];
+		p[0] += ((int(c.r) - int(p[0])) * int(alpha)) >> 8;
+		p[1] += ((int(c.g) - int(p[1])) * int(alpha)) >> 8;
+		p[2] += ((int(c.b) - int(p[2])) * int(alpha)) >> 8;
+	}
+
+	/**
+	 * Draw the part of a line within this band with Xiaolin Wu's
+	 * algorithm.  The "major" axis is the one along which the line
+	 * is longer; #transposed means it is y.
+	 */
+	void DrawWu(int major0, int minor0, int major1, int minor1,
+		    bool transposed, Color c) noexcept;
+};
+
+inline void
+BandRenderer::DrawWu(int major0, int minor0, int major1, int minor1,
+		     bool transposed, Color c) noexcept
+{
+	if (major0 > major1) {
+		std::swap(major0, major1);
+		std::swap(minor0, minor1);
+	}
+
+	/* the pixel columns whose centers are covered */
+	int first = (major0 + HALF) >> FRACTION_BITS;
+	int last = (major1 + HALF) >> FRACTION_BITS;
+
+	if (transposed) {
+		/* only the rows of this band */
+		first = std::max(first, y_begin);
+		last = std::min(last, y_end - 1);
+	}
+
+	if (first > last)
+		return;
+
+	const int d_major = major1 - major0;
+
+	/* the slope with 16 fractional bits */
+	const int64_t slope = d_major > 0
+		? (int64_t(minor1 - minor0) << 16) / d_major
+		: 0;
+
+	/* the minor coordinate at the center of the first column, with
+	   16 fractional bits, relative to pixel centers */
+	int64_t minor = (int64_t(minor0) << (16 - FRACTION_BITS)) +
+		((int64_t((first << FRACTION_BITS) + HALF - major0) * slope)
+		 >> FRACTION_BITS) -
+		(HALF << (16 - FRACTION_BITS));
+
+	for (int i = first; i <= last; ++i, minor += slope) {
+		const int pixel = int(minor >> 16);
+		const unsigned coverage = unsigned(minor >> 8) & 0xff;
+
+		if (transposed) {
+			Plot(pixel, i, c, 256 - coverage);
+			Plot(pixel + 1, i, c, coverage);
+		} else {
+			Plot(i, pixel, c, 256 - coverage);
+			Plot(i, pixel + 1, c, coverage);
+		}
+	}
+}
+
+void
+BandRenderer::Draw(const Segment &s) noexcept
+{
+	const int dx = s.x1 - s.x0, dy = s.y1 - s.y0;
+	if (std::abs(dx) >= std::abs(dy))
+		DrawWu(s.x0, s.y0, s.x1, s.y1, false, s.color);
+	else
+		DrawWu(s.y0, s.x0, s.y1, s.x1, true, s.color);
+}
+
+/**
+ * The rows touched by a segment, including the anti-aliasing
+ * neighbor.
+ */
+inline std::pair<int, int>
+GetRowRange(const Segment &s) noexcept
+{
+	const auto y = std::minmax(s.y0, s.y1);
+	return {(y.first - HALF) >> FRACTION_BITS,
+		((y.second - HALF) >> FRACTION_BITS) + 1};
+}
+
+}
+
+void
+RgbImage::WritePpm(const char *path) const
+{
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr)
+		throw FormatErrno("Failed to create %s", path);
+
+	AtScopeExit(file) { fclose(file); };
+
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+	if (fwrite(pixels.data(), 1, pixels.size(), file) != pixels.size() ||
+	    fflush(file) != 0)
+		throw FormatErrno("Failed to write %s", path);
+}
+
+RgbImage
+RenderPes(const PesReader &reader, const std::vector<PesStitch> &stitches,
+	  unsigned size, unsigned n_threads)
+{
+	if (size == 0)
+		throw std::runtime_error("Empty preview size");
+
+	const auto color_table = reader.GetColors();
+
+	/* find the extent of all stitches (not jumps) */
+	PesBounds bounds;
+	PesPoint position(0, 0);
+	for (const auto &s : stitches) {
+		if (s.type == PesStitch::Type::STITCH) {
+			bounds.Extend(position);
+			bounds.Extend(s.position);
+		}
+
+		position = s.position;
+	}
+
+	/* one pixel of margin for anti-aliasing */
+	const double extent = std::max(std::max(bounds.GetWidth(),
+						bounds.GetHeight()), 1u);
+	const double scale = size > 2 ? (size - 2) / extent : size / extent;
+
+	RgbImage image;
+	image.width = std::max(unsigned(bounds.GetWidth() * scale) + 2, 1u);
+	image.height = std::max(unsigned(bounds.GetHeight() * scale) + 2, 1u);
+	image.width = std::min(image.width, size);
+	image.height = std::min(image.height, size);
+	image.pixels.assign(size_t(image.width) * image.height * 3, 0xff);
+
+	if (bounds.IsEmpty())
+		return image;
+
+	/* convert to fixed point pixel coordinates; the pixel centers
+	   are at .5 */
+	const double fixed_scale = scale * ONE;
+	auto to_fixed_x = [&bounds, fixed_scale](int x){
+		return int((x - bounds.min_x) * fixed_scale) + ONE;
+	};
+	auto to_fixed_y = [&bounds, fixed_scale](int y){
+		return int((y - bounds.min_y) * fixed_scale) + ONE;
+	};
+
+	std::vector<Segment> segments;
+	segments.reserve(stitches.size());
+
+	Color color{0, 0, 0};
+	position = PesPoint(0, 0);
+	for (const auto &s : stitches) {
+		switch (s.type) {
+		case PesStitch::Type::STITCH:
+			segments.push_back({to_fixed_x(position.x),
+					    to_fixed_y(position.y),
+					    to_fixed_x(s.position.x),
+					    to_fixed_y(s.position.y),
+					    color});
+			break;
+
+		case PesStitch::Type::JUMP:
+		case PesStitch::Type::TRIM:
+			break;
+
+		case PesStitch::Type::COLOR_CHANGE:
+			if (s.color < color_table.size)
+				color = GetPesColor(color_table[s.color]);
+			break;
+		}
+
+		position = s.position;
+	}
+
+	/* sort the segments into bands, preserving their order (later
+	   stitches are on top): first count, then fill */
+	const unsigned n_bands = (image.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+	std::vector<size_t> band_start(n_bands + 1, 0);
+	for (const auto &s : segments) {
+		const auto rows = GetRowRange(s);
+		const int first = std::max(rows.first, 0) / int(BAND_HEIGHT);
+		const int last = std::min(std::max(rows.second, 0) / int(BAND_HEIGHT),
+					  int(n_bands) - 1);
+		for (int b = first; b <= last; ++b)
+			++band_start[b + 1];
+	}
+
+	for (unsigned b = 0; b < n_bands; ++b)
+		band_start[b + 1] += band_start[b];
+
+	std::vector<uint32_t> band_segments(band_start.back());
+	{
+		std::vector<size_t> fill(band_start.begin(), band_start.end() - 1);
+		for (size_t i = 0; i < segments.size(); ++i) {
+			const auto rows = GetRowRange(segments[i]);
+			const int first = std::max(rows.first, 0) / int(BAND_HEIGHT);
+			const int last = std::min(std::max(rows.second, 0) / int(BAND_HEIGHT),
+						  int(n_bands) - 1);
+			for (int b = first; b <= last; ++b)
+				band_segments[fill[b]++] = i;
+		}
+	}
+
+	std::atomic<unsigned> next_band(0);
+	auto worker = [&](){
+		unsigned b;
+		while ((b = next_band.fetch_add(1, std::memory_order_relaxed)) < n_bands) {
+			BandRenderer renderer(image, b * BAND_HEIGHT,
+					      std::min((b + 1) * BAND_HEIGHT,
+						       image.height));
+			for (size_t i = band_start[b]; i < band_start[b + 1]; ++i)
+				renderer.Draw(segments[band_segments[i]]);
+		}
+	};
+
+	n_threads = std::max(std::min(n_threads, n_bands), 1u);
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < n_threads; ++i)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto &i : threads)
+		i.join();
+
+	return image;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <stdint.h>
+
+struct PesStitch;
+class PesReader;
+
+/**
+ * An 8 bit RGB image.
+ */
+struct RgbImage {
+	unsigned width = 0, height = 0;
+
+	/**
+	 * Three bytes per pixel, row by row, without padding.
+	 */
+	std::vector<uint8_t> pixels;
+
+	/**
+	 * Write a binary PPM (P6) file.  Throws on error.
+	 */
+	void WritePpm(const char *path) const;
+};
+
+/**
+ * Draw the stitches of a PES file (from PesReader::Decode()) as
+ * anti-aliased lines in their thread colors on a white background.
+ * Jumps are not drawn.  The design is scaled to fit a square of the
+ * given size; the other side of the image may be smaller.
+ *
+ * The image is divided into horizontal bands, which are rendered by
+ * #n_threads threads in parallel.
+ */
+RgbImage
+RenderPes(const PesReader &reader, const std::vector<PesStitch> &stitches,
+	  unsigned size, unsigned n_threads);
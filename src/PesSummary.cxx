@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PesSummary.hxx"
+#include "PesReader.hxx"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#include <math.h>
+
+/**
+ * The size of a density cell [PES units]: one millimeter.
+ */
+static constexpr int DENSITY_CELL = 10;
+
+/**
+ * Designs up to this number of cells are analyzed with a dense
+ * grid: 64 MB for a square of 4 by 4 meters.
+ */
+static constexpr size_t MAX_GRID_CELLS = 16 * 1024 * 1024;
+
+gcc_const
+static inline int
+CellIndex(int value)
+{
+	/* round towards negative infinity */
+	return value >= 0
+		? value / DENSITY_CELL
+		: (value - DENSITY_CELL + 1) / DENSITY_CELL;
+}
+
+gcc_const
+static inline uint64_t
+MakeCellKey(PesPoint p)
+{
+	return (uint64_t(uint32_t(CellIndex(p.x))) << 32) |
+		uint32_t(CellIndex(p.y));
+}
+
+PesAnalyzer::PesAnalyzer() = default;
+PesAnalyzer::~PesAnalyzer() noexcept = default;
+
+PesSummary
+PesAnalyzer::Analyze(const PesReader &reader)
+{
+	stitches.clear();
+	reader.Decode(stitches);
+
+	PesSummary summary;
+	summary.width = reader.GetWidth();
+	summary.height = reader.GetHeight();
+
+	const auto color_table = reader.GetColors();
+	std::map<unsigned, PesColorUsage> colors;
+	PesColorUsage *current = nullptr;
+
+	SewingEstimate estimate;
+
+	/* consecutive jump/trim commands are one transition */
+	double jump_distance = 0;
+	bool in_jump = false, trimmed = false, after_color_change = true;
+
+	auto finish_jump = [&](){
+		if (!in_jump)
+			return;
+
+		if (after_color_change)
+			/* the thread has just been changed, no
+			   floating thread */
+			estimate.AddJump(jump_distance);
+		else
+			estimate.AddTransition(cost,
+					       trimmed ? Transition::TRIM : Transition::JUMP,
+					       jump_distance);
+
+		in_jump = trimmed = false;
+		jump_distance = 0;
+	};
+
+	unsigned n_blocks = 0;
+
+	PesPoint position(0, 0);
+	for (const auto &s : stitches) {
+		const PesPoint delta = s.position - position;
+		position = s.position;
+		const double length = sqrt(double(delta.x) * delta.x +
+					   double(delta.y) * delta.y);
+
+		if (s.type == PesStitch::Type::STITCH ||
+		    s.type == PesStitch::Type::COLOR_CHANGE)
+			finish_jump();
+
+		switch (s.type) {
+		case PesStitch::Type::STITCH:
+			++summary.stitches;
+			++estimate.stitches;
+			after_color_change = false;
+
+			summary.bounds.Extend(position);
+			summary.thread_length += length;
+			summary.longest_stitch = std::max(summary.longest_stitch,
+							  length);
+
+			if (current != nullptr) {
+				++current->stitches;
+				current->thread_length += length;
+			}
+			break;
+
+		case PesStitch::Type::JUMP:
+		case PesStitch::Type::TRIM:
+			if (s.type == PesStitch::Type::TRIM) {
+				++summary.trims;
+				trimmed = true;
+			} else
+				++summary.jumps;
+
+			in_jump = true;
+			jump_distance += length;
+			break;
+
+		case PesStitch::Type::COLOR_CHANGE:
+			if (s.color >= color_table.size)
+				throw std::runtime_error("Color index out of range");
+
+			{
+				const unsigned code = color_table[s.color];
+				current = &colors.emplace(code, PesColorUsage(code)).first->second;
+			}
+
+			++n_blocks;
+			after_color_change = true;
+			break;
+		}
+	}
+
+	finish_jump();
+
+	summary.color_changes = n_blocks > 0 ? n_blocks - 1 : 0;
+
+	summary.colors.reserve(colors.size());
+	for (const auto &i : colors)
+		summary.colors.push_back(i.second);
+
+	estimate.color_changes = summary.color_changes;
+	summary.seconds = estimate.GetSeconds(cost);
+
+	AnalyzeDensity(summary);
+	return summary;
+}
+
+inline void
+PesAnalyzer::AddDensityCell(PesSummary &summary, unsigned n,
+			    int cell_x, int cell_y) const noexcept
+{
+	if (n > summary.max_density) {
+		summary.max_density = n;
+		summary.max_density_position =
+			PesPoint(cell_x * DENSITY_CELL, cell_y * DENSITY_CELL);
+	}
+
+	if (n > hotspot_threshold)
+		++summary.hotspots;
+}
+
+void
+PesAnalyzer::AnalyzeDensity(PesSummary &summary)
+{
+	if (summary.bounds.IsEmpty())
+		return;
+
+	const int x0 = CellIndex(summary.bounds.min_x);
+	const int y0 = CellIndex(summary.bounds.min_y);
+	const size_t columns = CellIndex(summary.bounds.max_x) - x0 + 1;
+	const size_t rows = CellIndex(summary.bounds.max_y) - y0 + 1;
+
+	if (columns * rows <= MAX_GRID_CELLS) {
+		/* count in a dense grid, which is linear */
+		grid.assign(columns * rows, 0);
+		for (const auto &s : stitches)
+			if (s.type == PesStitch::Type::STITCH)
+				++grid[(CellIndex(s.position.y) - y0) * columns +
+				       CellIndex(s.position.x) - x0];
+
+		for (size_t i = 0; i < grid.size(); ++i)
+			if (grid[i] > 0)
+				AddDensityCell(summary, grid[i],
+					       x0 + int(i % columns),
+					       y0 + int(i / columns));
+		return;
+	}
+
+	/* the design is too large for a grid (which can only happen
+	   with a bogus file): sorting groups the needle points of each
+	   cell */
+	cells.clear();
+	cells.reserve(summary.stitches);
+	for (const auto &s : stitches)
+		if (s.type == PesStitch::Type::STITCH)
+			cells.push_back(MakeCellKey(s.position));
+
+	std::sort(cells.begin(), cells.end());
+
+	for (auto i = cells.begin(); i != cells.end();) {
+		const auto key = *i;
+		const auto end = std::find_if(i, cells.end(),
+					      [key](uint64_t k){ return k != key; });
+		AddDensityCell(summary, end - i,
+			       int32_t(key >> 32), int32_t(key));
+		i = end;
+	}
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "PesPoint.hxx"
+#include "PesBounds.hxx"
+#include "SewingCost.hxx"
+
+#include <vector>
+
+#include <stdint.h>
+
+struct PesStitch;
+class PesReader;
+
+/**
+ * The usage of one thread color in a PES file.
+ */
+struct PesColorUsage {
+	/**
+	 * The PES color code.
+	 */
+	unsigned color;
+
+	unsigned long stitches = 0;
+
+	/**
+	 * The length of all stitches in this color [PES units].
+	 */
+	double thread_length = 0;
+
+	explicit PesColorUsage(unsigned _color):color(_color) {}
+};
+
+/**
+ * Statistics about one PES file.  All lengths are in PES units.
+ */
+struct PesSummary {
+	/**
+	 * The design size from the header.
+	 */
+	unsigned width, height;
+
+	/**
+	 * The number of commands of each kind.  Long jumps consist of
+	 * several commands.
+	 */
+	unsigned long stitches = 0, jumps = 0, trims = 0;
+
+	/**
+	 * The number of thread changes, i.e. color blocks minus one.
+	 */
+	unsigned color_changes = 0;
+
+	/**
+	 * Sorted by color code; each code appears once, even if it
+	 * is used in several blocks.
+	 */
+	std::vector<PesColorUsage> colors;
+
+	/**
+	 * The bounding box of all needle points (relative to the
+	 * start position).
+	 */
+	PesBounds bounds;
+
+	double thread_length = 0;
+	double longest_stitch = 0;
+
+	/**
+	 * The highest number of needle points in one square
+	 * millimeter, and the lower left corner of that cell.
+	 */
+	unsigned max_density = 0;
+	PesPoint max_density_position{0, 0};
+
+	/**
+	 * The number of square millimeter cells which have more
+	 * needle points than #PesAnalyzer::hotspot_threshold.
+	 */
+	unsigned long hotspots = 0;
+
+	/**
+	 * The estimated sewing time.
+	 */
+	double seconds = 0;
+};
+
+/**
+ * Calculates #PesSummary objects.  The buffers are reused, so one
+ * instance should be used for many files (but only in one thread).
+ */
+class PesAnalyzer {
+	std::vector<PesStitch> stitches;
+	std::vector<unsigned> grid;
+	std::vector<uint64_t> cells;
+
+public:
+	SewingCostModel cost;
+
+	/**
+	 * The number of needle points per square millimeter above
+	 * which a cell counts as a hotspot (where the fabric may be
+	 * damaged or the thread may break).
+	 */
+	unsigned hotspot_threshold = 10;
+
+	PesAnalyzer();
+	~PesAnalyzer() noexcept;
+
+	/**
+	 * Throws on error.
+	 */
+	PesSummary Analyze(const PesReader &reader);
+
+private:
+	void AddDensityCell(PesSummary &summary, unsigned n,
+			    int cell_x, int cell_y) const noexcept;
+	void AnalyzeDensity(PesSummary &summary);
+};
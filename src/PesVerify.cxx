@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "PesVerify.hxx"
+#include "PesReader.hxx"
+#include "PesBounds.hxx"
+#include "PecGraphic.hxx"
+#include "StitchBlock.hxx"
+
+#include <stdexcept>
+
+#include <stdio.h>
+
+namespace {
+
+gcc_noreturn
+void
+ThrowMismatch(size_t index, const char *msg)
+{
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer),
+		 "PES verification failed at command %zu: %s", index, msg);
+	throw std::runtime_error(buffer);
+}
+
+void
+VerifyStitches(const PesReader &reader,
+	       const std::vector<PesStitch> &stitches)
+{
+	const auto colors = reader.GetColors();
+
+	/* the design size in the header is measured between the
+	   outermost needle points; jumps may go outside (e.g. from
+	   the origin to the first point) */
+	PesBounds bounds;
+	unsigned n_color_changes = 0;
+	for (size_t i = 0; i < stitches.size(); ++i) {
+		const auto &s = stitches[i];
+		switch (s.type) {
+		case PesStitch::Type::STITCH:
+			bounds.Extend(s.position);
+			break;
+
+		case PesStitch::Type::JUMP:
+		case PesStitch::Type::TRIM:
+			break;
+
+		case PesStitch::Type::COLOR_CHANGE:
+			if (s.color != n_color_changes)
+				ThrowMismatch(i, "unexpected color index");
+
+			++n_color_changes;
+			break;
+		}
+	}
+
+	if (n_color_changes != colors.size)
+		throw std::runtime_error("PES verification failed: color changes do not match the color table");
+
+	if (bounds.GetWidth() > reader.GetWidth() ||
+	    bounds.GetHeight() > reader.GetHeight())
+		throw std::runtime_error("PES verification failed: stitches exceed the design size");
+
+	/* one thumbnail for the whole design and one per color */
+	const auto graphic = reader.GetGraphic();
+	if (!graphic.IsNull() &&
+	    graphic.size != (colors.size + 1) * sizeof(PecThumbnail))
+		throw std::runtime_error("PES verification failed: wrong size of the PEC graphic");
+}
+
+}
+
+void
+VerifyPes(const PesReader &reader)
+{
+	std::vector<PesStitch> stitches;
+	reader.Decode(stitches);
+	VerifyStitches(reader, stitches);
+}
+
+void
+VerifyPes(const PesReader &reader, PesPoint origin,
+	  const std::vector<StitchBlock> &blocks)
+{
+	std::vector<PesStitch> stitches;
+	reader.Decode(stitches);
+	VerifyStitches(reader, stitches);
+
+	const auto colors = reader.GetColors();
+	if (colors.size != blocks.size())
+		throw std::runtime_error("PES verification failed: wrong number of colors");
+
+	size_t i = 0;
+	auto next = [&]() -> const PesStitch & {
+		if (i == stitches.size())
+			ThrowMismatch(i, "premature end");
+		return stitches[i++];
+	};
+
+	/* the decoder's positions are relative to the origin */
+	PesPoint position = origin;
+
+	for (size_t b = 0; b < blocks.size(); ++b) {
+		if (colors[b] != blocks[b].color)
+			ThrowMismatch(i, "wrong color in table");
+
+		if (next().type != PesStitch::Type::COLOR_CHANGE)
+			ThrowMismatch(i - 1, "color change expected");
+
+		for (const auto &run : blocks[b].runs) {
+			/* any number of stitches, jumps or trims may
+			   lead to the start of a run, and none if it
+			   is already there */
+			while (position != run.GetStart()) {
+				const auto &s = next();
+				if (s.type == PesStitch::Type::COLOR_CHANGE)
+					ThrowMismatch(i - 1, "run start not reached");
+				position = origin + s.position;
+			}
+
+			/* each needle point is reached by at least one
+			   stitch; long ones are split */
+			for (auto p = std::next(run.points.begin());
+			     p != run.points.end(); ++p) {
+				do {
+					const auto &s = next();
+					if (s.type != PesStitch::Type::STITCH)
+						ThrowMismatch(i - 1, "stitch expected");
+					position = origin + s.position;
+				} while (position != *p);
+			}
+		}
+	}
+
+	if (i != stitches.size())
+		ThrowMismatch(i, "extra commands");
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <vector>
+
+struct PesPoint;
+struct StitchBlock;
+class PesReader;
+
+/**
+ * Decode a PES file and check that it is consistent: the color
+ * changes match the color table, all stitches lie within the
+ * design size from the header, and the PEC graphic (if any) has one
+ * thumbnail per color.  Throws on error.
+ */
+void
+VerifyPes(const PesReader &reader);
+
+/**
+ * Like VerifyPes(const PesReader &), but also check that the file
+ * sews exactly the given blocks, i.e. that all needle points are
+ * reached in order.  Throws on error.
+ *
+ * @param origin the needle position where sewing started (in the
+ * coordinates of #blocks)
+ */
+void
+VerifyPes(const PesReader &reader, PesPoint origin,
+	  const std::vector<StitchBlock> &blocks);
@@ -19,9 +19,13 @@
 #include "PesWriter.hxx"
 #include "PesFormat.hxx"
 
+#include <algorithm>
+#include <stdexcept>
+
 #include <string.h>
 
-PesWriter::PesWriter(ConstBuffer<uint8_t> colors)
+PesWriter::PesWriter(ConstBuffer<uint8_t> colors,
+		     unsigned width, unsigned height)
 {
 	PesHeader header;
 
@@ -29,7 +33,8 @@ PesWriter::PesWriter(ConstBuffer<uint8_t> colors)
 	memcpy(p, &header, sizeof(header));
 	buffer.CommitWrite(sizeof(header));
 
-	PecHeader pec_header(200, 100);
+	PecHeader pec_header(std::min(width, 0xffffu),
+			     std::min(height, 0xffffu));
 
 	assert(colors.size <= pec_header.colors.size());
 	pec_header.n_colors = colors.size;
@@ -39,3 +44,24 @@ PesWriter::PesWriter(ConstBuffer<uint8_t> colors)
 	memcpy(p, &pec_header, sizeof(pec_header));
 	buffer.CommitWrite(sizeof(pec_header));
 }
+
+void
+PesWriter::AppendGraphic(ConstBuffer<uint8_t> graphic)
+{
+	constexpr size_t stitch_section = sizeof(PesHeader) +
+		PEC_STITCH_SECTION_OFFSET;
+	assert(buffer.size() >= stitch_section);
+
+	const size_t offset = buffer.size() - stitch_section;
+	if (offset > PEC_MAX_GRAPHIC_OFFSET)
+		throw std::runtime_error("Too many stitches for the PEC thumbnails"
+					 " (try --no-thumbnails)");
+
+	const uint32_t value = ToLE32(PecHeader::MakeGraphicOffset(offset));
+	memcpy(&buffer[sizeof(PesHeader) + offsetof(PecHeader, graphic_offset)],
+	       &value, sizeof(value));
+
+	uint8_t *p = buffer.PrepareWrite(graphic.size);
+	std::copy_n(graphic.data, graphic.size, p);
+	buffer.CommitWrite(graphic.size);
+}
@@ -19,7 +19,7 @@
 #ifndef PES_WRITER_HXX
 #define PES_WRITER_HXX
 
-#include "util/GrowingBuffer.hxx"
+#include "StitchWriter.hxx"
 
 #include <assert.h>
 #include <stdint.h>
@@ -49,7 +49,7 @@ PesCheckSmallStitch(int x, int y)
 inline constexpr bool
 PesCheckBigStitch(int delta)
 {
-	return delta >= -2048 && delta <= 2048;
+	return delta >= -2048 && delta <= 2047;
 }
 
 inline constexpr bool
@@ -96,11 +96,25 @@ PesEnd(uint8_t *p)
 	return p;
 }
 
-class PesWriter {
-	GrowingBuffer<uint8_t> buffer;
-
+/**
+ * Writes a PES file with a PEC section.
+ */
+class PesWriter final : public StitchWriter<PesWriter> {
 public:
-	explicit PesWriter(ConstBuffer<uint8_t> colors);
+	static constexpr int MIN_DELTA = -2048, MAX_DELTA = 2047;
+
+	/**
+	 * Construct a writer for stitch data only, without headers;
+	 * for assembling a file from several parts.
+	 */
+	PesWriter() = default;
+
+	/**
+	 * @param width the width of the design [PES units]
+	 * @param height the height of the design [PES units]
+	 */
+	PesWriter(ConstBuffer<uint8_t> colors,
+		  unsigned width, unsigned height);
 
 	void ColorChange(unsigned color) {
 		GenerateWrite(PesColorChange, color);
@@ -130,43 +144,8 @@ public:
 		}
 	}
 
-	/**
-	 * Stitch a line to the given relative position.  If the
-	 * dimensions exceed the encodable PES limits even for a "big"
-	 * stitch command, multiple stitch commands are emitted.
-	 */
-	void StitchLine(int x, int y) {
-		while (!PesCheckBigStitch(x, y)) {
-			int step_x = 0, step_y = 0;
-
-			if (x < -2048)
-				step_x = -2048;
-			else if (x > 2047)
-				step_x = 2047;
-
-			if (y < -2048)
-				step_y = -2048;
-			else if (y > 2047)
-				step_y = 2047;
-
-			BigStitch(step_x, step_y);
-
-			x -= step_x;
-			y -= step_y;
-		}
-
-		Stitch(x, y);
-	}
-
-	void Jump(int x, int y) {
-		while (x != 0 || y != 0) {
-			int step_x = std::max(-2048, std::min(2047, x));
-			int step_y = std::max(-2048, std::min(2047, y));
-			JumpStitch(step_x, step_y);
-
-			x -= step_x;
-			y -= step_y;
-		}
+	void TrimStitch(int x, int y) {
+		BigStitch(x, y, false, true);
 	}
 
 	void End() {
@@ -178,13 +157,15 @@ public:
 		return buffer;
 	}
 
-private:
-	template<typename F, typename... Args>
-	void GenerateWrite(F &&f, Args... args) {
-		uint8_t *p = buffer.PrepareWrite(4);
-		uint8_t *end = f(p, args...);
-		buffer.CommitWrite(end - p);
-	}
+	/**
+	 * Append the PEC graphic section after the end mark and
+	 * store its offset in the PEC header.  Only for writers which
+	 * were constructed with headers.
+	 *
+	 * Throws if the offset is not representable, i.e. the
+	 * stitches take more than 16 MB.
+	 */
+	void AppendGraphic(ConstBuffer<uint8_t> graphic);
 };
 
 #endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "ResourceBudget.hxx"
+
+ResourceBudget::ResourceBudget(const ResourceLimits &_limits)
+	:limits(_limits)
+{
+	if (limits.max_seconds > 0)
+		deadline = Clock::now() +
+			std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(limits.max_seconds));
+}
+
+void
+ResourceBudget::CheckClock()
+{
+	clock_countdown = 256;
+
+	if (limits.max_seconds > 0 && Clock::now() > deadline)
+		Fail("Time limit exceeded");
+}
+
+void
+ResourceBudget::Fail(const char *msg)
+{
+	throw ResourceLimitError(msg);
+}
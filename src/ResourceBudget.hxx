@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "Compiler.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Thrown when the input exceeds one of the #ResourceLimits.
+ */
+class ResourceLimitError final : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+/**
+ * Limits for the resources a conversion may consume, to protect a
+ * service from malicious or accidentally huge input.  The defaults
+ * are unlimited.
+ */
+struct ResourceLimits {
+	/**
+	 * The maximum number of vertices of all tessellated shapes.
+	 */
+	size_t max_vertices = SIZE_MAX;
+
+	/**
+	 * The maximum number of nested elements.
+	 */
+	unsigned max_depth = UINT32_MAX;
+
+	/**
+	 * The maximum number of generated needle points.
+	 */
+	size_t max_stitches = SIZE_MAX;
+
+	/**
+	 * The maximum wall time [seconds]; 0 means unlimited.
+	 */
+	double max_seconds = 0;
+
+	/**
+	 * The maximum ratio of expanded entity text to input bytes
+	 * which Expat accepts; 0 keeps Expat's default (100).
+	 */
+	float max_amplification = 0;
+};
+
+/**
+ * Tracks the resources consumed during one conversion and throws
+ * #ResourceLimitError when a limit is exceeded.  The checks are
+ * cheap enough for the inner loops; the clock is only read every
+ * few hundred calls.
+ */
+class ResourceBudget {
+	typedef std::chrono::steady_clock Clock;
+
+	const ResourceLimits limits;
+
+	size_t vertices = 0, stitches = 0;
+
+	Clock::time_point deadline;
+
+	/**
+	 * The number of CheckTime() calls until the clock is read
+	 * again.
+	 */
+	unsigned clock_countdown = 1;
+
+public:
+	explicit ResourceBudget(const ResourceLimits &_limits);
+
+	const ResourceLimits &GetLimits() const {
+		return limits;
+	}
+
+	void AddVertices(size_t n) {
+		vertices += n;
+		if (gcc_unlikely(vertices > limits.max_vertices))
+			Fail("Too many vertices");
+
+		CheckTime();
+	}
+
+	void AddStitches(size_t n) {
+		stitches += n;
+		if (gcc_unlikely(stitches > limits.max_stitches))
+			Fail("Too many stitches");
+
+		CheckTime();
+	}
+
+	/**
+	 * Forget the vertices counted so far, because parsing starts
+	 * over.
+	 */
+	void ResetVertices() {
+		vertices = 0;
+	}
+
+	void CheckDepth(unsigned depth) const {
+		if (gcc_unlikely(depth > limits.max_depth))
+			Fail("Elements are nested too deeply");
+	}
+
+	void CheckTime() {
+		if (gcc_unlikely(--clock_countdown == 0))
+			CheckClock();
+	}
+
+private:
+	void CheckClock();
+
+	gcc_noreturn gcc_cold
+	static void Fail(const char *msg);
+};
@@ -0,0 +1,407 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "RunOrder.hxx"
+#include "StitchRun.hxx"
+#include "SewingCost.hxx"
+#include "ResourceBudget.hxx"
+#include "Compiler.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+namespace {
+
+typedef int64_t SquareDistance;
+
+inline SquareDistance
+GetSquareDistance(PesPoint a, PesPoint b) noexcept
+{
+	const SquareDistance dx = a.x - b.x, dy = a.y - b.y;
+	return dx * dx + dy * dy;
+}
+
+inline double
+GetDistance(PesPoint a, PesPoint b) noexcept
+{
+	return sqrt(double(GetSquareDistance(a, b)));
+}
+
+/**
+ * A point where sewing a run may begin.
+ */
+struct Entry {
+	PesPoint point;
+
+	/**
+	 * The index of the run.
+	 */
+	unsigned run;
+
+	/**
+	 * The index into StitchRun::points.
+	 */
+	unsigned vertex;
+};
+
+/**
+ * A static 2-d tree over all entries which allows removing entries.
+ * It is stored implicitly: the root of the range [lo,hi) is at its
+ * middle, and the split axis alternates with each level.
+ */
+class EntryTree {
+	std::vector<Entry> entries;
+
+	/**
+	 * The number of entries which have not yet been removed from
+	 * the subtree rooted at each position.  Used to skip empty
+	 * subtrees.
+	 */
+	std::vector<unsigned> alive;
+
+	std::vector<bool> removed;
+
+public:
+	explicit EntryTree(std::vector<Entry> &&_entries)
+		:entries(std::move(_entries)),
+		 alive(entries.size()), removed(entries.size(), false) {
+		Build(0, entries.size(), false);
+	}
+
+	size_t size() const {
+		return entries.size();
+	}
+
+	const Entry &operator[](size_t position) const {
+		return entries[position];
+	}
+
+	/**
+	 * Find the position of the entry nearest to the given point.
+	 * At least one entry must remain.
+	 */
+	gcc_pure
+	size_t FindNearest(PesPoint p) const noexcept {
+		assert(alive[entries.size() / 2] > 0);
+
+		size_t best = entries.size();
+		SquareDistance best_distance = INT64_MAX;
+		FindNearest(p, 0, entries.size(), false, best, best_distance);
+		assert(best < entries.size());
+		return best;
+	}
+
+	void Remove(size_t position) noexcept;
+
+private:
+	void Build(size_t lo, size_t hi, bool axis_y) noexcept;
+
+	void FindNearest(PesPoint p, size_t lo, size_t hi, bool axis_y,
+			 size_t &best,
+			 SquareDistance &best_distance) const noexcept;
+};
+
+void
+EntryTree::Build(size_t lo, size_t hi, bool axis_y) noexcept
+{
+	if (lo >= hi)
+		return;
+
+	const size_t mid = lo + (hi - lo) / 2;
+	std::nth_element(std::next(entries.begin(), lo),
+			 std::next(entries.begin(), mid),
+			 std::next(entries.begin(), hi),
+			 [axis_y](const Entry &a, const Entry &b){
+				 return axis_y
+					 ? a.point.y < b.point.y
+					 : a.point.x < b.point.x;
+			 });
+
+	alive[mid] = hi - lo;
+
+	Build(lo, mid, !axis_y);
+	Build(mid + 1, hi, !axis_y);
+}
+
+void
+EntryTree::FindNearest(PesPoint p, size_t lo, size_t hi, bool axis_y,
+		       size_t &best,
+		       SquareDistance &best_distance) const noexcept
+{
+	if (lo >= hi)
+		return;
+
+	const size_t mid = lo + (hi - lo) / 2;
+	if (alive[mid] == 0)
+		return;
+
+	const Entry &e = entries[mid];
+	if (!removed[mid]) {
+		const auto d = GetSquareDistance(p, e.point);
+		if (d < best_distance) {
+			best = mid;
+			best_distance = d;
+		}
+	}
+
+	const SquareDistance diff = axis_y
+		? p.y - e.point.y
+		: p.x - e.point.x;
+
+	if (diff < 0) {
+		FindNearest(p, lo, mid, !axis_y, best, best_distance);
+		if (diff * diff < best_distance)
+			FindNearest(p, mid + 1, hi, !axis_y,
+				    best, best_distance);
+	} else {
+		FindNearest(p, mid + 1, hi, !axis_y, best, best_distance);
+		if (diff * diff < best_distance)
+			FindNearest(p, lo, mid, !axis_y, best, best_distance);
+	}
+}
+
+void
+EntryTree::Remove(size_t position) noexcept
+{
+	assert(!removed[position]);
+	removed[position] = true;
+
+	size_t lo = 0, hi = entries.size();
+	while (true) {
+		const size_t mid = lo + (hi - lo) / 2;
+		assert(alive[mid] > 0);
+		--alive[mid];
+
+		if (position == mid)
+			break;
+
+		if (position < mid)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+}
+
+void
+GreedyOrder(std::vector<StitchRun> &runs, PesPoint cursor,
+	    ResourceBudget *budget)
+{
+	std::vector<Entry> entries;
+	for (unsigned i = 0; i < runs.size(); ++i) {
+		const auto &points = runs[i].points;
+		assert(!points.empty());
+
+		if (runs[i].IsClosed()) {
+			for (unsigned j = 0; j + 1 < points.size(); ++j)
+				entries.push_back({points[j], i, j});
+		} else {
+			entries.push_back({points.front(), i, 0});
+			if (points.size() > 1)
+				entries.push_back({points.back(), i,
+						   unsigned(points.size() - 1)});
+		}
+	}
+
+	EntryTree tree(std::move(entries));
+
+	/* for each run, the tree positions of its entries */
+	std::vector<unsigned> offsets(runs.size() + 1, 0);
+	for (size_t i = 0; i < tree.size(); ++i)
+		++offsets[tree[i].run + 1];
+	std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+	std::vector<unsigned> positions(tree.size());
+	{
+		std::vector<unsigned> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < tree.size(); ++i)
+			positions[fill[tree[i].run]++] = i;
+	}
+
+	std::vector<StitchRun> result;
+	result.reserve(runs.size());
+
+	for (size_t n = runs.size(); n > 0; --n) {
+		if (budget != nullptr)
+			budget->CheckTime();
+
+		const Entry &e = tree[tree.FindNearest(cursor)];
+		const unsigned r = e.run;
+		StitchRun &run = runs[r];
+
+		if (run.IsClosed())
+			run.RotateClosed(e.vertex);
+		else if (e.vertex != 0)
+			run.Reverse();
+
+		for (unsigned i = offsets[r]; i < offsets[r + 1]; ++i)
+			tree.Remove(positions[i]);
+
+		cursor = run.GetEnd();
+		result.push_back(std::move(run));
+	}
+
+	runs = std::move(result);
+}
+
+/**
+ * Improve the order with 2-opt moves: reversing a sequence of runs
+ * (including reversing each run) if that reduces the jump distance.
+ * Only sequences up to RunOrderOptions::window are considered.
+ */
+void
+TwoOpt(std::vector<StitchRun> &runs, const PesPoint cursor,
+       const RunOrderOptions &options)
+{
+	const size_t n = runs.size();
+	if (n < 2)
+		return;
+
+	/* the moves work on these two arrays; the runs are rearranged
+	   only at the end */
+	std::vector<unsigned> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::vector<bool> flipped(n, false);
+
+	auto start = [&](size_t i){
+		const auto &run = runs[order[i]];
+		return flipped[i] ? run.GetEnd() : run.GetStart();
+	};
+
+	auto end = [&](size_t i){
+		const auto &run = runs[order[i]];
+		return flipped[i] ? run.GetStart() : run.GetEnd();
+	};
+
+	const SewingCostModel *const cost_model = options.cost;
+	auto cost = [cost_model](PesPoint a, PesPoint b){
+		const double distance = GetDistance(a, b);
+		return cost_model != nullptr
+			? cost_model->GetTransitionSeconds(distance)
+			: distance;
+	};
+
+	for (unsigned pass = 0; pass < options.max_passes; ++pass) {
+		bool improved = false;
+
+		for (size_t i = 0; i < n; ++i) {
+			if (options.budget != nullptr)
+				options.budget->CheckTime();
+
+			const PesPoint a = i > 0 ? end(i - 1) : cursor;
+			PesPoint b = start(i);
+			double ab = cost(a, b);
+
+			const size_t j_end = std::min(n, i + options.window);
+			for (size_t j = i; j < j_end; ++j) {
+				const PesPoint c = end(j);
+				double delta = cost(a, c) - ab;
+				if (j + 1 < n) {
+					const PesPoint d = start(j + 1);
+					delta += cost(b, d) - cost(c, d);
+				}
+
+				if (delta < -1e-6) {
+					std::reverse(order.begin() + i,
+						     order.begin() + j + 1);
+					std::reverse(flipped.begin() + i,
+						     flipped.begin() + j + 1);
+					for (size_t k = i; k <= j; ++k)
+						flipped[k] = !flipped[k];
+
+					b = start(i);
+					ab = cost(a, b);
+					improved = true;
+				}
+			}
+		}
+
+		if (!improved)
+			break;
+	}
+
+	std::vector<StitchRun> result;
+	result.reserve(n);
+	for (size_t i = 0; i < n; ++i) {
+		result.push_back(std::move(runs[order[i]]));
+		if (flipped[i])
+			result.back().Reverse();
+	}
+
+	runs = std::move(result);
+}
+
+/**
+ * Order one group of runs which may be sewn in any order.
+ *
+ * @return the needle position after the last run
+ */
+PesPoint
+OrderGroup(std::vector<StitchRun> &runs, PesPoint cursor,
+	   const RunOrderOptions &options)
+{
+	if (runs.empty())
+		return cursor;
+
+	GreedyOrder(runs, cursor, options.budget);
+
+	if (options.two_opt)
+		TwoOpt(runs, cursor, options);
+
+	return runs.back().GetEnd();
+}
+
+}
+
+void
+OrderRuns(std::vector<StitchRun> &runs, PesPoint cursor,
+	  const RunOrderOptions &options)
+{
+	runs.erase(std::remove_if(runs.begin(), runs.end(),
+				  [](const StitchRun &r){
+					  return r.points.empty();
+				  }),
+		   runs.end());
+
+	/* a path whose fill and outline have the same color ends up
+	   in one block; the fill runs are ordered first and the
+	   outline runs after them, so no outline gets buried below
+	   its own fill */
+	const auto middle =
+		std::stable_partition(runs.begin(), runs.end(),
+				      [](const StitchRun &r){
+					      return !r.outline;
+				      });
+	if (middle == runs.begin() || middle == runs.end()) {
+		OrderGroup(runs, cursor, options);
+		return;
+	}
+
+	std::vector<StitchRun> outline(std::make_move_iterator(middle),
+				       std::make_move_iterator(runs.end()));
+	runs.erase(middle, runs.end());
+
+	cursor = OrderGroup(runs, cursor, options);
+	OrderGroup(outline, cursor, options);
+
+	std::move(outline.begin(), outline.end(), std::back_inserter(runs));
+}
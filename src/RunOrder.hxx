@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <vector>
+
+struct PesPoint;
+struct StitchRun;
+struct SewingCostModel;
+class ResourceBudget;
+
+struct RunOrderOptions {
+	/**
+	 * If set, 2-opt minimizes the estimated sewing time of the
+	 * transitions instead of the jump distance.
+	 */
+	const SewingCostModel *cost = nullptr;
+
+	/**
+	 * Refine the greedy order with 2-opt moves?
+	 */
+	bool two_opt = true;
+
+	/**
+	 * 2-opt only considers reversing up to this many consecutive
+	 * runs, which keeps it linear in the number of runs.
+	 */
+	unsigned window = 32;
+
+	/**
+	 * The maximum number of 2-opt passes.
+	 */
+	unsigned max_passes = 4;
+
+	/**
+	 * If set, the time limit is checked while ordering.
+	 */
+	ResourceBudget *budget = nullptr;
+};
+
+/**
+ * Reorder the runs of one color block to reduce the total jump
+ * distance.  The order is built by a greedy nearest neighbor search
+ * over all possible entry points (both ends of open runs, all points
+ * of closed runs) using a k-d tree, optionally followed by a windowed
+ * 2-opt refinement.  Runs may be reversed, and closed runs may be
+ * rotated to start at a different point.  Outline runs stay behind
+ * all fill runs.
+ *
+ * @param cursor the needle position before the first run
+ */
+void
+OrderRuns(std::vector<StitchRun> &runs, PesPoint cursor,
+	  const RunOrderOptions &options);
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "RunningStitch.hxx"
+#include "SvgData.hxx"
+#include "ResourceBudget.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+namespace {
+
+/**
+ * Calculate the length of each segment and return the sum.  The
+ * first loop has no branches and no dependencies between iterations;
+ * with -fno-math-errno (see meson.build), the compiler vectorizes it.
+ */
+double
+SegmentLengths(double *gcc_restrict lengths,
+	       const SvgCompactVertex *gcc_restrict v,
+	       size_t n_segments) noexcept
+{
+	for (size_t i = 0; i < n_segments; ++i) {
+		const double dx = v[i + 1].GetX() - v[i].GetX();
+		const double dy = v[i + 1].GetY() - v[i].GetY();
+		lengths[i] = sqrt(dx * dx + dy * dy);
+	}
+
+	double total = 0;
+	for (size_t i = 0; i < n_segments; ++i)
+		total += lengths[i];
+
+	return total;
+}
+
+}
+
+void
+RunningStitch(std::vector<SvgPoint> &dest, ConstBuffer<SvgCompactVertex> src,
+	      double length, double min_length, ResourceBudget *budget)
+{
+	assert(length > 0);
+	assert(min_length <= length);
+
+	if (src.size < 2)
+		return;
+
+	const size_t n_segments = src.size - 1;
+
+	/* thread_local to avoid reallocating for each subpath */
+	static thread_local std::vector<double> lengths;
+	lengths.resize(n_segments);
+
+	const double total = SegmentLengths(lengths.data(), src.data,
+					    n_segments);
+	if (total < min_length || total <= 0)
+		return;
+
+	/* choose the number of stitches so all of them have the same
+	   length, within the given limits */
+	size_t n_stitches = size_t(ceil(total / length));
+	if (min_length > 0)
+		n_stitches = std::min(n_stitches,
+				      size_t(total / min_length));
+	n_stitches = std::max(n_stitches, size_t(1));
+
+	if (budget != nullptr)
+		budget->AddStitches(n_stitches + 1);
+
+	const double step = total / n_stitches;
+
+	dest.reserve(dest.size() + n_stitches + 1);
+	dest.push_back(src.front().GetPoint());
+
+	/* walk along the segments; "position" is the distance of the
+	   next needle point from the start of segment "i" */
+	size_t i = 0;
+	double position = step;
+	for (size_t stitch = 1; stitch < n_stitches; ++stitch) {
+		while (position > lengths[i] && i + 1 < n_segments) {
+			position -= lengths[i];
+			++i;
+		}
+
+		const SvgPoint a = src[i].GetPoint(), b = src[i + 1].GetPoint();
+		const double t = lengths[i] > 0 ? position / lengths[i] : 0;
+		dest.push_back(a + (b - a) * t);
+
+		position += step;
+	}
+
+	/* the last needle point is exactly at the end to avoid
+	   rounding errors */
+	dest.push_back(src.back().GetPoint());
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "util/ConstBuffer.hxx"
+
+#include <vector>
+
+struct SvgPoint;
+struct SvgCompactVertex;
+class ResourceBudget;
+
+/**
+ * Generate running stitches along a polyline.  The whole arc length
+ * is divided into stitches of equal length not exceeding #length
+ * (and not shorter than #min_length), i.e. the distance remaining
+ * at a vertex is carried over to the next segment.
+ *
+ * Runs in O(n) for n vertices plus the number of stitches.
+ *
+ * @param dest the needle points are appended here; the first one is
+ * the start of the polyline, the last one is its end; nothing is
+ * appended if the polyline is shorter than #min_length
+ * @param src the polyline; vertex types are ignored
+ * @param length the target stitch length
+ * @param min_length the minimum stitch length
+ * @param budget if not nullptr, the needle points are accounted here
+ * before they are generated
+ */
+void
+RunningStitch(std::vector<SvgPoint> &dest, ConstBuffer<SvgCompactVertex> src,
+	      double length, double min_length,
+	      ResourceBudget *budget=nullptr);
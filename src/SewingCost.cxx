@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SewingCost.hxx"
+
+double
+SewingCostModel::GetJumpSeconds(double distance) const noexcept
+{
+	/* one machine cycle plus moving the frame */
+	return GetStitchSeconds() + distance / jump_speed;
+}
+
+double
+SewingCostModel::GetTransitionSeconds(Transition t,
+				      double distance) const noexcept
+{
+	switch (t) {
+	case Transition::SEW:
+		return GetStitchSeconds();
+
+	case Transition::JUMP:
+		return GetJumpSeconds(distance) +
+			(distance > max_float_distance
+			 ? manual_trim_seconds
+			 : 0);
+
+	case Transition::TRIM:
+		return trim_seconds + GetJumpSeconds(distance);
+	}
+
+	gcc_unreachable();
+}
+
+Transition
+SewingCostModel::ChooseTransition(double distance) const noexcept
+{
+	if (distance <= max_sew_distance)
+		return Transition::SEW;
+
+	return GetTransitionSeconds(Transition::TRIM, distance) <
+		GetTransitionSeconds(Transition::JUMP, distance)
+		? Transition::TRIM
+		: Transition::JUMP;
+}
+
+void
+SewingEstimate::AddTransition(const SewingCostModel &model, Transition t,
+			      double distance) noexcept
+{
+	switch (t) {
+	case Transition::SEW:
+		++stitches;
+		break;
+
+	case Transition::JUMP:
+		AddJump(distance);
+		if (distance > model.max_float_distance)
+			++manual_trims;
+		break;
+
+	case Transition::TRIM:
+		AddJump(distance);
+		++trims;
+		break;
+	}
+}
+
+double
+SewingEstimate::GetSeconds(const SewingCostModel &model) const noexcept
+{
+	return stitches * model.GetStitchSeconds() +
+		jumps * model.GetStitchSeconds() +
+		jump_distance / model.jump_speed +
+		trims * model.trim_seconds +
+		manual_trims * model.manual_trim_seconds +
+		color_changes * model.color_change_seconds;
+}
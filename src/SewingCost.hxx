@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "Compiler.h"
+
+/**
+ * How the needle gets from the end of one run to the start of the
+ * next one.
+ */
+enum class Transition {
+	/**
+	 * Sew a regular stitch; only for short distances, because the
+	 * thread remains visible.
+	 */
+	SEW,
+
+	/**
+	 * Jump without cutting the thread; the floating thread has to
+	 * be cut by hand later if it is too long.
+	 */
+	JUMP,
+
+	/**
+	 * Cut the thread, then jump.
+	 */
+	TRIM,
+};
+
+/**
+ * A simple model of the time an embroidery machine needs for a
+ * design.  All distances are in PES units (1/10 mm).
+ */
+struct SewingCostModel {
+	/**
+	 * The machine speed [stitches per minute].
+	 */
+	double stitches_per_minute = 600;
+
+	/**
+	 * The speed of the frame during a jump [PES units per
+	 * second].
+	 */
+	double jump_speed = 1000;
+
+	/**
+	 * The time to cut the thread [seconds].
+	 */
+	double trim_seconds = 6;
+
+	/**
+	 * The time to change the thread [seconds]; this is done by the
+	 * operator on single-needle machines.
+	 */
+	double color_change_seconds = 45;
+
+	/**
+	 * The time the operator needs to cut a floating thread after
+	 * the machine has finished [seconds].
+	 */
+	double manual_trim_seconds = 10;
+
+	/**
+	 * Transitions up to this distance may be sewn as a regular
+	 * stitch.
+	 */
+	double max_sew_distance = 20;
+
+	/**
+	 * Floating threads up to this length may remain; longer jumps
+	 * require a trim (by the machine or manually).
+	 */
+	double max_float_distance = 30;
+
+	gcc_pure
+	double GetStitchSeconds() const noexcept {
+		return 60. / stitches_per_minute;
+	}
+
+	gcc_pure
+	double GetJumpSeconds(double distance) const noexcept;
+
+	/**
+	 * Calculate the time needed for the given transition.
+	 */
+	gcc_pure
+	double GetTransitionSeconds(Transition t,
+				    double distance) const noexcept;
+
+	/**
+	 * Choose the cheapest transition for the given distance.
+	 */
+	gcc_pure
+	Transition ChooseTransition(double distance) const noexcept;
+
+	/**
+	 * Calculate the time needed for the cheapest transition.
+	 */
+	gcc_pure
+	double GetTransitionSeconds(double distance) const noexcept {
+		return GetTransitionSeconds(ChooseTransition(distance),
+					    distance);
+	}
+};
+
+/**
+ * Counters collected while encoding a design, from which the sewing
+ * time can be estimated.
+ */
+struct SewingEstimate {
+	unsigned long stitches = 0;
+	unsigned long jumps = 0;
+	unsigned long trims = 0;
+	unsigned color_changes = 0;
+
+	/**
+	 * The total jump distance.
+	 */
+	double jump_distance = 0;
+
+	/**
+	 * The number of floating threads which need to be cut by hand.
+	 */
+	unsigned long manual_trims = 0;
+
+	/**
+	 * Count a jump which does not leave a floating thread, e.g.
+	 * after a color change.
+	 */
+	void AddJump(double distance) noexcept {
+		++jumps;
+		jump_distance += distance;
+	}
+
+	void AddTransition(const SewingCostModel &model, Transition t,
+			   double distance) noexcept;
+
+	gcc_pure
+	double GetSeconds(const SewingCostModel &model) const noexcept;
+};
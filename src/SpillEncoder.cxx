@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SpillEncoder.hxx"
+#include "StitchEncoder.hxx"
+#include "PecGraphic.hxx"
+#include "PesReader.hxx"
+#include "PesFormat.hxx"
+#include "SewingCost.hxx"
+#include "SvgData.hxx"
+#include "MemoryStats.hxx"
+#include "util/SystemError.hxx"
+
+#include <stdexcept>
+#include <algorithm>
+#include <array>
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+gcc_pure
+static double
+GetDistance(PesPoint a, PesPoint b)
+{
+	return hypot(a.x - b.x, a.y - b.y);
+}
+
+SpillEncoder::ColorSpill &
+SpillEncoder::GetSpill(unsigned color)
+{
+	auto i = std::find_if(spills.begin(), spills.end(),
+			      [color](const std::unique_ptr<ColorSpill> &s){
+				      return s->color == color;
+			      });
+	if (i != spills.end())
+		return **i;
+
+	/* the PES header has room for 255 color changes */
+	if (spills.size() >= 255)
+		throw std::runtime_error("Too many color changes");
+
+	spills.emplace_back(new ColorSpill(color));
+	return *spills.back();
+}
+
+void
+SpillEncoder::AddRuns(unsigned color)
+{
+	if (runs.empty())
+		return;
+
+	const ScopeMemorySubsystem scope(MemorySubsystem::PES);
+
+	auto &spill = GetSpill(color);
+	const size_t old_size = spill.writer.GetData().size;
+	n_runs += runs.size();
+
+	for (const auto &run : runs) {
+		bounds.Extend({run.points.data(), run.points.size()});
+
+		Transition transition;
+		if (spill.empty) {
+			/* the jump to the first run of this color is
+			   written by Finish() */
+			spill.start = spill.cursor = run.GetStart();
+			spill.empty = false;
+			transition = Transition::SEW;
+		} else {
+			const double distance =
+				GetDistance(spill.cursor, run.GetStart());
+			transition = cost.ChooseTransition(distance);
+			estimate.AddTransition(cost, transition, distance);
+		}
+
+		EncodeRun(spill.writer, spill.cursor, run, transition);
+		estimate.stitches += run.points.size() - 1;
+	}
+
+	buffered += spill.writer.GetData().size - old_size;
+	if (buffered >= max_buffered) {
+		for (auto &s : spills)
+			s->Flush();
+		buffered = 0;
+	}
+}
+
+void
+SpillEncoder::OnSvgPath(SvgPath &&path)
+{
+	const ScopeMemorySubsystem scope(MemorySubsystem::STITCHES);
+
+	/* the fill is sewn first, and the outline on top of it */
+	if (path.fill) {
+		runs.clear();
+		FillToRuns(runs, path, options);
+		AddRuns(path.fill_pes_color);
+	}
+
+	if (path.stroke) {
+		runs.clear();
+		StrokeToRuns(runs, path, options);
+		AddRuns(path.stroke_pes_color);
+	}
+}
+
+/**
+ * Copy the stitches of one color from the spill file to the output
+ * and draw them into the PEC graphic on the way; the design bounds
+ * were not known yet when they were encoded.
+ *
+ * @param position the needle position at the start of the spill
+ * file
+ * @param graphic nullptr if there are no thumbnails
+ * @return the number of bytes copied
+ */
+static uint64_t
+CopySpill(int fd, const SpillFile &file, PesPoint position,
+	  PecGraphic *graphic)
+{
+	std::vector<PesStitch> stitches;
+	uint8_t buffer[65536];
+
+	/* the bytes of a command which was incomplete at the end of
+	   the previous chunk */
+	size_t fill = 0;
+
+	uint64_t offset = 0;
+	while (true) {
+		const size_t nbytes = file.Read(offset, {buffer + fill,
+							 sizeof(buffer) - fill});
+		if (nbytes == 0)
+			break;
+
+		offset += nbytes;
+		WriteFull(fd, {buffer + fill, nbytes});
+		if (graphic == nullptr)
+			continue;
+
+		fill += nbytes;
+
+		stitches.clear();
+		const size_t consumed = DecodePesStitches({buffer, fill},
+							  position, stitches);
+		for (const auto &i : stitches) {
+			if (i.type == PesStitch::Type::STITCH)
+				graphic->LineTo(i.position);
+			else
+				graphic->MoveTo(i.position);
+		}
+
+		fill -= consumed;
+		memmove(buffer, buffer + consumed, fill);
+	}
+
+	if (fill > 0)
+		throw std::runtime_error("Truncated temporary file");
+
+	return offset;
+}
+
+void
+SpillEncoder::Finish(int fd, bool center, bool thumbnails)
+{
+	/* fail early, not after all stitches have been written */
+	if (thumbnails && lseek(fd, 0, SEEK_CUR) < 0)
+		throw MakeErrno("--max-memory needs a seekable output file");
+
+	/* sew the colors in the same order as GroupLayersByColor() */
+	std::sort(spills.begin(), spills.end(),
+		  [](const std::unique_ptr<ColorSpill> &a,
+		     const std::unique_ptr<ColorSpill> &b){
+			  return a->color < b->color;
+		  });
+
+	std::array<uint8_t, 256> colors;
+	unsigned n_colors = 0;
+	for (const auto &i : spills)
+		colors[n_colors++] = i->color;
+
+	/* to center the design, pretend the needle starts at the
+	   design's center; the first jump then moves the center to the
+	   origin */
+	PesPoint cursor = center && !bounds.IsEmpty()
+		? bounds.GetCenter()
+		: PesPoint(0, 0);
+
+	PesWriter writer({&colors.front(), n_colors},
+			 bounds.GetWidth(), bounds.GetHeight());
+	PecGraphic graphic(bounds, n_colors);
+
+	/* the number of bytes written so far */
+	uint64_t position = 0;
+
+	unsigned next_color_index = 0;
+	for (auto &i : spills) {
+		if (next_color_index > 0)
+			++estimate.color_changes;
+		graphic.SetBlock(next_color_index);
+		writer.ColorChange(next_color_index++);
+
+		/* the thread has just been changed, no need to trim */
+		const auto relative = i->start - cursor;
+		estimate.AddJump(GetDistance(cursor, i->start));
+		writer.Jump(relative.x, relative.y);
+		graphic.MoveTo(i->start);
+		cursor = i->cursor;
+
+		WriteFull(fd, writer.GetData());
+		position += writer.GetData().size;
+		writer.Clear();
+
+		i->Flush();
+		position += CopySpill(fd, i->file, i->start,
+				      thumbnails ? &graphic : nullptr);
+	}
+
+	writer.End();
+	WriteFull(fd, writer.GetData());
+	position += writer.GetData().size;
+
+	if (!thumbnails)
+		return;
+
+	/* append the graphic and patch its offset into the header,
+	   which has already been written */
+	const uint64_t graphic_offset = position -
+		(sizeof(PesHeader) + PEC_STITCH_SECTION_OFFSET);
+	if (graphic_offset > PEC_MAX_GRAPHIC_OFFSET)
+		throw std::runtime_error("Too many stitches for the PEC thumbnails"
+					 " (try --no-thumbnails)");
+
+	WriteFull(fd, graphic.GetData());
+
+	const uint32_t value =
+		ToLE32(PecHeader::MakeGraphicOffset(graphic_offset));
+	if (pwrite(fd, &value, sizeof(value),
+		   sizeof(PesHeader) + offsetof(PecHeader, graphic_offset)) < 0)
+		throw MakeErrno("Failed to write file");
+}
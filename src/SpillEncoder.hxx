@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "SvgParser.hxx"
+#include "SpillFile.hxx"
+#include "PesWriter.hxx"
+#include "PesPoint.hxx"
+#include "PesBounds.hxx"
+#include "Stitcher.hxx"
+#include "StitchRun.hxx"
+
+#include <memory>
+#include <vector>
+
+struct SewingCostModel;
+struct SewingEstimate;
+
+/**
+ * Converts a document of any size with bounded memory usage.  Each
+ * path is stitched and encoded as soon as the parser has finished it;
+ * the encoded stitches of each color are kept in a #PesWriter buffer
+ * which is moved to a #SpillFile when all buffers together exceed a
+ * limit.  Finally, the PES file is assembled from the spill files.
+ *
+ * The paths of one color are sewn in document order, and all of
+ * them before the next color (like "--order=document
+ * --ignore-z-order"), because reordering would need the whole
+ * design in memory.
+ */
+class SpillEncoder final : public SvgPathHandler {
+	struct ColorSpill {
+		const unsigned color;
+
+		SpillFile file;
+
+		/**
+		 * Stitches which have not yet been moved to #file.
+		 */
+		PesWriter writer;
+
+		/**
+		 * The start of the first run, which is where the needle
+		 * has to jump after the color change.
+		 */
+		PesPoint start;
+
+		/**
+		 * The end of the last run.
+		 */
+		PesPoint cursor;
+
+		/**
+		 * Has a run been added yet?
+		 */
+		bool empty = true;
+
+		explicit ColorSpill(unsigned _color):color(_color) {}
+
+		/**
+		 * Move the buffered stitches to #file and free the
+		 * buffer; otherwise, each color would keep the
+		 * capacity of its largest buffer, and all of them
+		 * together could use up to (number of colors) times
+		 * the limit.
+		 */
+		void Flush() {
+			file.Append(writer.GetData());
+			writer.Release();
+		}
+	};
+
+	const StitchOptions &options;
+	const SewingCostModel &cost;
+	SewingEstimate &estimate;
+
+	/**
+	 * Flush all buffers when they together reach this size
+	 * [bytes].
+	 */
+	const size_t max_buffered;
+	size_t buffered = 0;
+
+	std::vector<std::unique_ptr<ColorSpill>> spills;
+
+	PesBounds bounds;
+
+	unsigned long n_runs = 0;
+
+	/**
+	 * Reused for each path.
+	 */
+	std::vector<StitchRun> runs;
+
+public:
+	SpillEncoder(const StitchOptions &_options,
+		     const SewingCostModel &_cost, SewingEstimate &_estimate,
+		     size_t _max_buffered)
+		:options(_options), cost(_cost), estimate(_estimate),
+		 max_buffered(_max_buffered) {}
+
+	const PesBounds &GetBounds() const {
+		return bounds;
+	}
+
+	unsigned long GetRunCount() const {
+		return n_runs;
+	}
+
+	unsigned GetColorCount() const {
+		return spills.size();
+	}
+
+	/**
+	 * Write the PES file.  Call this after the whole document has
+	 * been parsed.
+	 *
+	 * The PEC graphic offset is written into the header
+	 * afterwards, so the file must be seekable if there are
+	 * thumbnails.
+	 *
+	 * @param center center the design in the hoop
+	 * @param thumbnails generate the PEC thumbnails?
+	 */
+	void Finish(int fd, bool center, bool thumbnails);
+
+private:
+	ColorSpill &GetSpill(unsigned color);
+
+	void AddRuns(unsigned color);
+
+	/* virtual methods from SvgPathHandler */
+	void OnSvgPath(SvgPath &&path) override;
+};
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SpillFile.hxx"
+#include "util/SystemError.hxx"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+static int
+OpenTemporaryFile()
+{
+	const char *dir = getenv("TMPDIR");
+	if (dir == nullptr || *dir == 0)
+		dir = "/tmp";
+
+	int fd = open(dir, O_TMPFILE|O_RDWR|O_CLOEXEC, 0600);
+	if (fd >= 0)
+		return fd;
+
+	if (errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL)
+		throw FormatErrno("Failed to create temporary file in %s", dir);
+
+	/* the filesystem does not support O_TMPFILE: create a named
+	   file and unlink it right away */
+	char path[4096];
+	if ((size_t)snprintf(path, sizeof(path), "%s/svg2pes.XXXXXX",
+			     dir) >= sizeof(path))
+		throw std::runtime_error("TMPDIR is too long");
+
+	fd = mkostemp(path, O_CLOEXEC);
+	if (fd < 0)
+		throw FormatErrno("Failed to create temporary file in %s", dir);
+
+	unlink(path);
+	return fd;
+}
+
+SpillFile::SpillFile()
+	:fd(OpenTemporaryFile()) {}
+
+SpillFile::~SpillFile() noexcept
+{
+	close(fd);
+}
+
+void
+WriteFull(int fd, ConstBuffer<uint8_t> src)
+{
+	while (!src.IsEmpty()) {
+		ssize_t nbytes = write(fd, src.data, src.size);
+		if (nbytes < 0) {
+			if (errno == EINTR)
+				continue;
+			throw MakeErrno("Failed to write file");
+		}
+
+		src.skip_front(nbytes);
+	}
+}
+
+void
+SpillFile::Append(ConstBuffer<uint8_t> src)
+{
+	WriteFull(fd, src);
+}
+
+size_t
+SpillFile::Read(uint64_t offset, WritableBuffer<uint8_t> dest) const
+{
+	while (true) {
+		ssize_t nbytes = pread(fd, dest.data, dest.size, offset);
+		if (nbytes >= 0)
+			return nbytes;
+
+		if (errno != EINTR)
+			throw MakeErrno("Failed to read temporary file");
+	}
+}
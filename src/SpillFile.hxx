@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
+
+#include <stdint.h>
+
+/**
+ * An anonymous append-only temporary file in $TMPDIR (or /tmp).  It
+ * is unlinked from the start, so it disappears when it is closed,
+ * even if the process crashes.
+ */
+class SpillFile {
+	int fd;
+
+public:
+	SpillFile();
+	~SpillFile() noexcept;
+
+	SpillFile(const SpillFile &) = delete;
+	SpillFile &operator=(const SpillFile &) = delete;
+
+	void Append(ConstBuffer<uint8_t> src);
+
+	/**
+	 * Read data from the given position.
+	 *
+	 * @return the number of bytes read; 0 at the end of the file
+	 */
+	size_t Read(uint64_t offset, WritableBuffer<uint8_t> dest) const;
+};
+
+/**
+ * Write the whole buffer to the file descriptor.
+ */
+void
+WriteFull(int fd, ConstBuffer<uint8_t> src);
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "StitchRun.hxx"
+
+#include <vector>
+
+/**
+ * A sequence of runs sewn in one color, i.e. without a color change.
+ */
+struct StitchBlock {
+	/**
+	 * The PES color index.
+	 */
+	unsigned color;
+
+	std::vector<StitchRun> runs;
+
+	StitchBlock() = default;
+	explicit StitchBlock(unsigned _color):color(_color) {}
+};
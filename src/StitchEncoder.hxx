@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "StitchBlock.hxx"
+#include "PecGraphic.hxx"
+#include "SewingCost.hxx"
+
+/**
+ * Move the needle from #cursor to the start of the run using the
+ * given transition, then sew the run.
+ *
+ * @param writer a #StitchWriter implementation
+ * @param cursor the current needle position; it is updated to the
+ * end of the run
+ * @param graphic if not nullptr, the stitches are drawn into this
+ * thumbnail
+ */
+template<typename W>
+void
+EncodeRun(W &writer, PesPoint &cursor, const StitchRun &run,
+	  Transition transition, PecGraphic *graphic=nullptr)
+{
+	const auto relative = run.GetStart() - cursor;
+	switch (transition) {
+	case Transition::SEW:
+		if (relative != PesPoint(0, 0))
+			writer.StitchLine(relative.x, relative.y);
+		break;
+
+	case Transition::JUMP:
+		writer.Jump(relative.x, relative.y);
+		break;
+
+	case Transition::TRIM:
+		writer.Jump(relative.x, relative.y, true);
+		break;
+	}
+
+	cursor = run.GetStart();
+
+	if (graphic != nullptr) {
+		if (transition == Transition::SEW)
+			graphic->LineTo(cursor);
+		else
+			graphic->MoveTo(cursor);
+	}
+
+	for (auto i = std::next(run.points.begin()); i != run.points.end(); ++i) {
+		const auto point = *i;
+		const auto delta = point - cursor;
+		cursor = point;
+
+		writer.StitchLine(delta.x, delta.y);
+
+		if (graphic != nullptr)
+			graphic->LineTo(point);
+	}
+}
+
+/**
+ * Encode blocks whose runs have been planned (see
+ * StitchRun::transition), beginning with a color change to each
+ * block.
+ *
+ * @param writer a #StitchWriter implementation
+ * @param cursor the initial needle position
+ * @param graphic if not nullptr, the stitches are drawn into this
+ * PEC graphic
+ */
+template<typename W>
+void
+EncodeBlocks(W &writer, PesPoint cursor,
+	     const std::vector<StitchBlock> &blocks,
+	     PecGraphic *graphic=nullptr)
+{
+	unsigned color_index = 0;
+	for (const auto &block : blocks) {
+		if (graphic != nullptr)
+			graphic->SetBlock(color_index);
+		writer.ColorChange(color_index++);
+
+		for (const auto &run : block.runs)
+			EncodeRun(writer, cursor, run, run.transition,
+				  graphic);
+	}
+}
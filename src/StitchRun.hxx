@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "PesPoint.hxx"
+#include "SewingCost.hxx"
+
+#include <algorithm>
+#include <vector>
+
+#include <assert.h>
+
+/**
+ * A sequence of needle points (absolute PES coordinates) which is
+ * sewn without a jump.  The machine jumps to the first point.
+ */
+struct StitchRun {
+	std::vector<PesPoint> points;
+
+	/**
+	 * How the needle gets here from the previous run; chosen when
+	 * the runs are planned, before they are encoded.
+	 */
+	Transition transition = Transition::JUMP;
+
+	/**
+	 * Is this part of an outline?  Outlines are sewn on top of
+	 * the fill, so reordering must not move them before the fill
+	 * runs of the same block.
+	 */
+	bool outline = false;
+
+	/**
+	 * Is this a closed loop?  Then sewing may start at any of its
+	 * points.
+	 */
+	bool IsClosed() const {
+		return points.size() > 2 && points.front() == points.back();
+	}
+
+	PesPoint GetStart() const {
+		return points.front();
+	}
+
+	PesPoint GetEnd() const {
+		return points.back();
+	}
+
+	/**
+	 * Sew this run in the opposite direction.
+	 */
+	void Reverse();
+
+	/**
+	 * Rotate a closed run so it starts (and ends) at the given
+	 * point.
+	 */
+	void RotateClosed(size_t start);
+};
+
+inline void
+StitchRun::Reverse()
+{
+	std::reverse(points.begin(), points.end());
+}
+
+inline void
+StitchRun::RotateClosed(size_t start)
+{
+	assert(IsClosed());
+	assert(start < points.size());
+
+	if (start == 0 || start == points.size() - 1)
+		return;
+
+	/* drop the duplicate end point, rotate, and close the loop
+	   again */
+	points.pop_back();
+	std::rotate(points.begin(), std::next(points.begin(), start),
+		    points.end());
+	points.push_back(points.front());
+}
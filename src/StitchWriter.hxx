@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "util/GrowingBuffer.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+
+#include <stdint.h>
+
+/**
+ * Common code of the embroidery file writers.  The file format is
+ * implemented by the derived class (CRTP), which lets the compiler
+ * inline the format's primitives into the stitch loop:
+ *
+ * - MIN_DELTA, MAX_DELTA: the range of one stitch or jump command
+ *   [PES units]
+ * - Stitch(x, y): one stitch within that range
+ * - JumpStitch(x, y): one jump within that range
+ * - TrimStitch(x, y): cut the thread, then jump
+ * - ColorChange(index): switch to the given color; index 0 is the
+ *   first color and is selected before the first stitch
+ * - End(): the end of the design
+ *
+ * All coordinates are relative to the previous needle position, with
+ * the y axis pointing down.
+ */
+template<typename Derived>
+class StitchWriter {
+protected:
+	GrowingBuffer<uint8_t> buffer;
+
+	StitchWriter() = default;
+	~StitchWriter() = default;
+
+public:
+	static constexpr bool CheckDelta(int delta) {
+		return delta >= Derived::MIN_DELTA && delta <= Derived::MAX_DELTA;
+	}
+
+	static constexpr bool CheckDelta(int x, int y) {
+		return CheckDelta(x) && CheckDelta(y);
+	}
+
+	/**
+	 * Stitch a line to the given relative position.  If the
+	 * dimensions exceed the limits of one stitch command,
+	 * multiple stitch commands are emitted.
+	 */
+	void StitchLine(int x, int y) {
+		while (!CheckDelta(x, y)) {
+			int step_x = 0, step_y = 0;
+
+			if (x < Derived::MIN_DELTA)
+				step_x = Derived::MIN_DELTA;
+			else if (x > Derived::MAX_DELTA)
+				step_x = Derived::MAX_DELTA;
+
+			if (y < Derived::MIN_DELTA)
+				step_y = Derived::MIN_DELTA;
+			else if (y > Derived::MAX_DELTA)
+				step_y = Derived::MAX_DELTA;
+
+			GetDerived().Stitch(step_x, step_y);
+
+			x -= step_x;
+			y -= step_y;
+		}
+
+		GetDerived().Stitch(x, y);
+	}
+
+	/**
+	 * Move to the given relative position without sewing.
+	 *
+	 * @param trim cut the thread before moving
+	 */
+	void Jump(int x, int y, bool trim) {
+		while (x != 0 || y != 0) {
+			int step_x = std::max(int(Derived::MIN_DELTA),
+					      std::min(int(Derived::MAX_DELTA), x));
+			int step_y = std::max(int(Derived::MIN_DELTA),
+					      std::min(int(Derived::MAX_DELTA), y));
+			if (trim) {
+				GetDerived().TrimStitch(step_x, step_y);
+				trim = false;
+			} else
+				GetDerived().JumpStitch(step_x, step_y);
+
+			x -= step_x;
+			y -= step_y;
+		}
+	}
+
+	void Jump(int x, int y) {
+		Jump(x, y, false);
+	}
+
+	/**
+	 * Return the data written so far.
+	 */
+	ConstBuffer<uint8_t> GetData() const {
+		return buffer;
+	}
+
+	/**
+	 * Discard the data written so far (after it has been copied
+	 * elsewhere).
+	 */
+	void Clear() {
+		buffer.clear();
+	}
+
+	/**
+	 * Like Clear(), but also free the buffer, for a writer which
+	 * may not be used again for a while.
+	 */
+	void Release() {
+		buffer.reset();
+	}
+
+protected:
+	Derived &GetDerived() {
+		return static_cast<Derived &>(*this);
+	}
+
+	/**
+	 * Call a function which encodes one command of up to 4 bytes
+	 * at the given pointer and returns the new end.
+	 */
+	template<typename F, typename... Args>
+	void GenerateWrite(F &&f, Args... args) {
+		uint8_t *p = buffer.PrepareWrite(4);
+		uint8_t *end = f(p, args...);
+		buffer.CommitWrite(end - p);
+	}
+
+	/**
+	 * Reserve space for a header which is filled in later.
+	 */
+	void ReserveHeader(size_t size) {
+		std::fill_n(buffer.PrepareWrite(size), size, 0);
+		buffer.CommitWrite(size);
+	}
+};
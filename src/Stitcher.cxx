@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Stitcher.hxx"
+#include "StitchRun.hxx"
+#include "RunningStitch.hxx"
+#include "FillStitch.hxx"
+#include "SvgData.hxx"
+#include "Trace.hxx"
+
+namespace {
+
+/**
+ * Quantize needle points to PES coordinates and append them as a new
+ * run.  Needle points which collapse into their predecessor are
+ * omitted.
+ */
+void
+AppendRun(std::vector<StitchRun> &dest, const std::vector<SvgPoint> &needles)
+{
+	if (needles.empty())
+		return;
+
+	dest.emplace_back();
+	auto &points = dest.back().points;
+	points.reserve(needles.size());
+
+	for (const auto &i : needles) {
+		const PesPoint p(i);
+		if (points.empty() || p != points.back())
+			points.push_back(p);
+	}
+}
+
+}
+
+void
+StrokeToRuns(std::vector<StitchRun> &dest, const SvgPath &path,
+	     const StitchOptions &options)
+{
+	TraceSpan span("stitch", "stroke");
+	const size_t old_size = dest.size();
+
+	std::vector<SvgPoint> needles;
+
+	const auto &points = path.points;
+	for (size_t end = 0; end < points.size();) {
+		/* find the end of this subpath */
+		const size_t start = end++;
+		while (end < points.size() &&
+		       !points[end].IsMove())
+			++end;
+
+		needles.clear();
+		RunningStitch(needles, {&points[start], end - start},
+			      options.length, options.min_length,
+			      options.budget);
+		AppendRun(dest, needles);
+	}
+
+	for (size_t i = old_size; i < dest.size(); ++i)
+		dest[i].outline = true;
+
+	span.SetCount(dest.size() - old_size);
+}
+
+void
+FillToRuns(std::vector<StitchRun> &dest, const SvgPath &path,
+	   const StitchOptions &options)
+{
+	TraceSpan span("stitch", "fill");
+	const size_t old_size = dest.size();
+
+	FillStitchOptions fill_options;
+	fill_options.spacing = options.fill_spacing;
+	fill_options.length = options.length;
+	fill_options.min_length = options.min_length;
+	fill_options.budget = options.budget;
+
+	std::vector<std::vector<SvgPoint>> runs;
+	FillStitch(runs, path, fill_options);
+
+	for (const auto &run : runs)
+		AppendRun(dest, run);
+
+	span.SetCount(dest.size() - old_size);
+}
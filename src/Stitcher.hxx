@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "PesPoint.hxx"
+
+#include <vector>
+
+struct SvgPath;
+struct StitchRun;
+class ResourceBudget;
+
+/**
+ * Parameters for converting SVG paths to stitches.
+ */
+struct StitchOptions {
+	/**
+	 * The target length of running stitches [SVG units].
+	 */
+	double length = MillimetersToSvg(2.5);
+
+	/**
+	 * Shorter stitches are not emitted [SVG units].
+	 */
+	double min_length = MillimetersToSvg(0.3);
+
+	/**
+	 * The distance between two rows of fill stitches [SVG units].
+	 */
+	double fill_spacing = MillimetersToSvg(0.4);
+
+	/**
+	 * If set, the generated needle points are accounted here.
+	 */
+	ResourceBudget *budget = nullptr;
+};
+
+/**
+ * Generate running stitches along the outline of the given path.
+ * Each subpath becomes one #StitchRun.
+ */
+void
+StrokeToRuns(std::vector<StitchRun> &dest, const SvgPath &path,
+	     const StitchOptions &options);
+
+/**
+ * Generate fill stitches for the inside of the given path.
+ */
+void
+FillToRuns(std::vector<StitchRun> &dest, const SvgPath &path,
+	   const StitchOptions &options);
@@ -104,7 +104,8 @@ SvgArc::GetPoint(double t) const noexcept
 }
 
 void
-SvgArcToLines(SvgPath &dest, SvgPoint start, SvgPoint radius,
+SvgArcToLines(std::vector<SvgVertex> &dest,
+	      SvgPoint start, SvgPoint radius,
 	      double rotation, bool large_arc, bool sweep,
 	      SvgPoint end)
 {
@@ -112,8 +113,8 @@ SvgArcToLines(SvgPath &dest, SvgPoint start, SvgPoint radius,
 
 	const SvgArc arc(start, radius, rotation, large_arc, sweep, end);
 	for (double t = 0.03; t < 1; t += 0.03)
-		dest.points.push_back(SvgVertex(SvgVertex::Type::LINE,
-						arc.GetPoint(t)));
+		dest.push_back(SvgVertex(SvgVertex::Type::LINE,
+					 arc.GetPoint(t)));
 
-	dest.points.push_back(SvgVertex(SvgVertex::Type::LINE, end));
+	dest.push_back(SvgVertex(SvgVertex::Type::LINE, end));
 }
@@ -19,14 +19,17 @@
 #ifndef SVG_ARC_HXX
 #define SVG_ARC_HXX
 
-struct SvgPath;
+#include <vector>
+
 struct SvgPoint;
+struct SvgVertex;
 
 /**
  * Generate a line path from the given SVG arc.
  */
 void
-SvgArcToLines(SvgPath &dest, SvgPoint start, SvgPoint radius,
+SvgArcToLines(std::vector<SvgVertex> &dest,
+	      SvgPoint start, SvgPoint radius,
 	      double rotation, bool large_arc, bool sweep,
 	      SvgPoint end);
 
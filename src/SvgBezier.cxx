@@ -21,25 +21,26 @@
 #include "BezierCurve.hxx"
 
 void
-SvgQuadraticBezierToLines(SvgPath &dest, SvgPoint start,
+SvgQuadraticBezierToLines(std::vector<SvgVertex> &dest, SvgPoint start,
 			  SvgPoint control, SvgPoint end) noexcept
 {
 	const QuadraticBezierCurve<SvgPoint> curve(start, control, end);
 	for (double t = 0.03; t < 1; t += 0.06)
-		dest.points.push_back(SvgVertex(SvgVertex::Type::LINE,
-						curve.GetPoint(t)));
+		dest.push_back(SvgVertex(SvgVertex::Type::LINE,
+					 curve.GetPoint(t)));
 
-	dest.points.push_back(SvgVertex(SvgVertex::Type::LINE, end));
+	dest.push_back(SvgVertex(SvgVertex::Type::LINE, end));
 }
 
 void
-SvgCubicBezierToLines(SvgPath &dest, SvgPoint start, SvgPoint control1,
-		      SvgPoint control2, SvgPoint end) noexcept
+SvgCubicBezierToLines(std::vector<SvgVertex> &dest, SvgPoint start,
+		      SvgPoint control1, SvgPoint control2,
+		      SvgPoint end) noexcept
 {
 	const CubicBezierCurve<SvgPoint> curve(start, control1, control2, end);
 	for (double t = 0.03; t < 1; t += 0.06)
-		dest.points.push_back(SvgVertex(SvgVertex::Type::LINE,
-						curve.GetPoint(t)));
+		dest.push_back(SvgVertex(SvgVertex::Type::LINE,
+					 curve.GetPoint(t)));
 
-	dest.points.push_back(SvgVertex(SvgVertex::Type::LINE, end));
+	dest.push_back(SvgVertex(SvgVertex::Type::LINE, end));
 }
@@ -18,19 +18,22 @@
 
 #pragma once
 
-struct SvgPath;
+#include <vector>
+
 struct SvgPoint;
+struct SvgVertex;
 
 /**
  * Generate a line path from the given SVG quadratic bezier curve.
  */
 void
-SvgQuadraticBezierToLines(SvgPath &dest, SvgPoint start,
+SvgQuadraticBezierToLines(std::vector<SvgVertex> &dest, SvgPoint start,
 			  SvgPoint control, SvgPoint end) noexcept;
 
 /**
  * Generate a line path from the given SVG cubic bezier curve.
  */
 void
-SvgCubicBezierToLines(SvgPath &dest, SvgPoint start, SvgPoint control1,
-		      SvgPoint control2, SvgPoint end) noexcept;
+SvgCubicBezierToLines(std::vector<SvgVertex> &dest, SvgPoint start,
+		      SvgPoint control1, SvgPoint control2,
+		      SvgPoint end) noexcept;
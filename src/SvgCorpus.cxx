@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SvgCorpus.hxx"
+#include "XorShiftRandom.hxx"
+
+#include <algorithm>
+
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+/**
+ * The size of the canvas of all documents [px].
+ */
+constexpr unsigned CANVAS = 1000;
+
+constexpr const char *palette[] = {
+	"#000000", "#ffffff", "#ff0000", "#00a000", "#0000ff",
+	"#ffd700", "#8b4513", "#ff69b4",
+};
+
+constexpr unsigned N_PALETTE = sizeof(palette) / sizeof(palette[0]);
+
+void
+BeginDocument(FILE *file)
+{
+	fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		"<svg xmlns=\"http://www.w3.org/2000/svg\""
+		" xmlns:xlink=\"http://www.w3.org/1999/xlink\""
+		" width=\"%u\" height=\"%u\" viewBox=\"0 0 %u %u\">\n",
+		CANVAS, CANVAS, CANVAS, CANVAS);
+}
+
+void
+EndDocument(FILE *file)
+{
+	fputs("</svg>\n", file);
+}
+
+/**
+ * Filled blobs made of cubic Bézier curves: the common case of
+ * traced artwork.
+ */
+void
+GeneratePaths(FILE *file, unsigned scale)
+{
+	XorShiftRandom random(1);
+
+	BeginDocument(file);
+
+	const unsigned n_paths = 2000 * scale;
+	constexpr unsigned N_CURVES = 20;
+
+	for (unsigned i = 0; i < n_paths; ++i) {
+		const double cx = random.Next(30., CANVAS - 30.);
+		const double cy = random.Next(30., CANVAS - 30.);
+		const double r = random.Next(5., 25.);
+
+		fprintf(file, "<path fill=\"%s\" d=\"M%.2f,%.2f",
+			palette[random.Next(N_PALETTE)], cx + r, cy);
+
+		for (unsigned j = 1; j <= N_CURVES; ++j) {
+			const double a0 = (j - 0.66) * 2 * M_PI / N_CURVES;
+			const double a1 = (j - 0.33) * 2 * M_PI / N_CURVES;
+			const double a2 = j * 2 * M_PI / N_CURVES;
+			const double r0 = r * random.Next(0.8, 1.2);
+			const double r1 = r * random.Next(0.8, 1.2);
+			const double r2 = j < N_CURVES
+				? r * random.Next(0.9, 1.1)
+				: r;
+
+			fprintf(file, " C%.2f,%.2f %.2f,%.2f %.2f,%.2f",
+				cx + r0 * cos(a0), cy + r0 * sin(a0),
+				cx + r1 * cos(a1), cy + r1 * sin(a1),
+				cx + r2 * cos(a2), cy + r2 * sin(a2));
+		}
+
+		fputs("z\"/>\n", file);
+	}
+
+	EndDocument(file);
+}
+
+/**
+ * Deeply nested groups, each with a transform and a small shape:
+ * stresses the group stack and matrix composition.  As with
+ * GenerateCircles(), there is only one color.
+ */
+void
+GenerateNested(FILE *file, unsigned scale)
+{
+	XorShiftRandom random(2);
+
+	BeginDocument(file);
+
+	const unsigned n_trees = 400 * scale;
+	constexpr unsigned DEPTH = 50;
+
+	for (unsigned i = 0; i < n_trees; ++i) {
+		fprintf(file, "<g transform=\"translate(%.1f %.1f)\">\n",
+			random.Next(100., CANVAS - 100.),
+			random.Next(100., CANVAS - 100.));
+
+		for (unsigned j = 0; j < DEPTH; ++j) {
+			switch (random.Next(3)) {
+			case 0:
+				fprintf(file, "<g transform=\"rotate(%.1f)\">",
+					random.Next(-20., 20.));
+				break;
+
+			case 1:
+				fprintf(file, "<g transform=\"translate(%.1f,%.1f) scale(0.97)\">",
+					random.Next(-2., 2.), random.Next(-2., 2.));
+				break;
+
+			case 2:
+				fprintf(file, "<g transform=\"matrix(0.98 0.05 -0.05 0.98 %.1f %.1f)\">",
+					random.Next(-2., 2.), random.Next(-2., 2.));
+				break;
+			}
+
+			fprintf(file, "<path fill=\"none\" stroke=\"#000000\" d=\"M0,0 l%.1f,%.1f\"/>\n",
+				random.Next(-20., 20.), random.Next(-20., 20.));
+		}
+
+		for (unsigned j = 0; j <= DEPTH; ++j)
+			fputs("</g>", file);
+		fputs("\n", file);
+	}
+
+	EndDocument(file);
+}
+
+/**
+ * A grid of small squares, each with its own color, specified
+ * alternately as attribute and as style: stresses color matching
+ * and the style cache.
+ */
+void
+GenerateColors(FILE *file, unsigned scale)
+{
+	XorShiftRandom random(3);
+
+	BeginDocument(file);
+
+	constexpr unsigned COLUMNS = 100;
+	const unsigned rows = 200 * scale;
+	const double cell = double(CANVAS) / std::max(COLUMNS, rows);
+
+	for (unsigned y = 0; y < rows; ++y) {
+		for (unsigned x = 0; x < COLUMNS; ++x) {
+			const unsigned color = random.Next(0x1000000);
+			if ((x + y) % 2 == 0)
+				fprintf(file, "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\" fill=\"#%06x\"/>\n",
+					x * cell, y * cell, cell * 0.8, cell * 0.8,
+					color);
+			else
+				fprintf(file, "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\" style=\"fill:#%06x;stroke:none\"/>\n",
+					x * cell, y * cell, cell * 0.8, cell * 0.8,
+					color);
+		}
+	}
+
+	EndDocument(file);
+}
+
+/**
+ * One stroked path with a huge "d" attribute: stresses the path data
+ * parser and Expat's attribute buffer.
+ */
+void
+GenerateHuge(FILE *file, unsigned scale)
+{
+	XorShiftRandom random(4);
+
+	BeginDocument(file);
+
+	const unsigned n_commands = 200000 * scale;
+
+	fprintf(file, "<path fill=\"none\" stroke=\"#000000\" d=\"M%u,%u",
+		CANVAS / 2, CANVAS / 2);
+
+	/* a random walk which stays on the canvas */
+	double x = CANVAS / 2, y = CANVAS / 2;
+	for (unsigned i = 0; i < n_commands; ++i) {
+		double dx = random.Next(-4., 4.), dy = random.Next(-4., 4.);
+		if (x + dx < 10 || x + dx > CANVAS - 10)
+			dx = -dx;
+		if (y + dy < 10 || y + dy > CANVAS - 10)
+			dy = -dy;
+
+		if (i % 4 == 3)
+			fprintf(file, " c%.2f,%.2f %.2f,%.2f %.2f,%.2f",
+				dx / 3 + random.Next(-1., 1.), dy / 3,
+				dx * 2 / 3, dy * 2 / 3 + random.Next(-1., 1.),
+				dx, dy);
+		else
+			fprintf(file, " l%.2f,%.2f", dx, dy);
+
+		x += dx;
+		y += dy;
+	}
+
+	fputs("\"/>\n", file);
+
+	EndDocument(file);
+}
+
+/**
+ * Embedded base64 images (which are skipped) between a few shapes:
+ * stresses the XML parser with large amounts of irrelevant data.
+ */
+void
+GenerateImages(FILE *file, unsigned scale)
+{
+	static constexpr char base64[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	XorShiftRandom random(5);
+
+	BeginDocument(file);
+
+	const unsigned n_images = 200 * scale;
+	constexpr size_t IMAGE_SIZE = 64 * 1024;
+
+	for (unsigned i = 0; i < n_images; ++i) {
+		const double x = random.Next(0., CANVAS - 100.);
+		const double y = random.Next(0., CANVAS - 100.);
+
+		fprintf(file, "<image x=\"%.1f\" y=\"%.1f\" width=\"100\" height=\"100\""
+			" xlink:href=\"data:image/png;base64,", x, y);
+
+		for (size_t j = 0; j < IMAGE_SIZE; ++j) {
+			if (j > 0 && j % 76 == 0)
+				putc('\n', file);
+			putc(base64[random.Next(64)], file);
+		}
+
+		fputs("\"/>\n", file);
+
+		fprintf(file, "<rect x=\"%.1f\" y=\"%.1f\" width=\"20\" height=\"10\""
+			" fill=\"none\" stroke=\"%s\"/>\n",
+			x, y, palette[random.Next(N_PALETTE)]);
+	}
+
+	EndDocument(file);
+}
+
+/**
+ * Circles and elliptical arcs: stresses the arc tessellation.  All
+ * of them have the same color, because overlapping shapes of
+ * different colors would each need a color change.
+ */
+void
+GenerateCircles(FILE *file, unsigned scale)
+{
+	XorShiftRandom random(6);
+
+	BeginDocument(file);
+
+	const unsigned n_shapes = 20000 * scale;
+
+	for (unsigned i = 0; i < n_shapes; ++i) {
+		const double x = random.Next(40., CANVAS - 40.);
+		const double y = random.Next(40., CANVAS - 40.);
+		const char *color = palette[0];
+
+		if (i % 2 == 0)
+			fprintf(file, "<circle cx=\"%.2f\" cy=\"%.2f\" r=\"%.2f\""
+				" fill=\"none\" stroke=\"%s\"/>\n",
+				x, y, random.Next(2., 30.), color);
+		else
+			fprintf(file, "<path fill=\"none\" stroke=\"%s\""
+				" d=\"M%.2f,%.2f a%.2f,%.2f %.1f %u %u %.2f,%.2f"
+				" a%.2f,%.2f %.1f %u %u %.2f,%.2f\"/>\n",
+				color, x, y,
+				random.Next(5., 30.), random.Next(5., 30.),
+				random.Next(0., 360.),
+				random.Next(2), random.Next(2),
+				random.Next(-30., 30.), random.Next(-30., 30.),
+				random.Next(5., 30.), random.Next(5., 30.),
+				random.Next(0., 360.),
+				random.Next(2), random.Next(2),
+				random.Next(-30., 30.), random.Next(-30., 30.));
+	}
+
+	EndDocument(file);
+}
+
+/**
+ * Small outlines stacked around the center of the canvas, so that
+ * all of them overlap each other: stresses the z-order constraints
+ * of the layer scheduler.  The colors change in bands, because each
+ * band needs its own color block.
+ */
+void
+GenerateOverlap(FILE *file, unsigned scale)
+{
+	XorShiftRandom random(7);
+
+	BeginDocument(file);
+
+	const unsigned n_shapes = 4000 * scale;
+	constexpr unsigned N_BANDS = 100;
+	constexpr double CENTER = CANVAS / 2;
+
+	for (unsigned i = 0; i < n_shapes; ++i) {
+		/* each rectangle contains the center */
+		const double x = CENTER - random.Next(5., 40.);
+		const double y = CENTER - random.Next(5., 40.);
+		const unsigned band = i * N_BANDS / n_shapes;
+
+		fprintf(file, "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\""
+			" fill=\"none\" stroke=\"%s\"/>\n",
+			x, y,
+			CENTER - x + random.Next(5., 40.),
+			CENTER - y + random.Next(5., 40.),
+			palette[band % N_PALETTE]);
+	}
+
+	EndDocument(file);
+}
+
+}
+
+const SvgCorpusClass svg_corpus_classes[] = {
+	{"paths", "filled paths made of cubic curves", GeneratePaths},
+	{"nested", "deeply nested groups with transforms", GenerateNested},
+	{"colors", "many small shapes with distinct colors", GenerateColors},
+	{"huge", "one path with a huge \"d\" attribute", GenerateHuge},
+	{"images", "embedded base64 images", GenerateImages},
+	{"circles", "circles and elliptical arcs", GenerateCircles},
+	{"overlap", "overlapping outlines of many colors", GenerateOverlap},
+	{nullptr, nullptr, nullptr},
+};
+
+const SvgCorpusClass *
+FindSvgCorpusClass(const char *name) noexcept
+{
+	for (const auto *i = svg_corpus_classes; i->name != nullptr; ++i)
+		if (strcmp(i->name, name) == 0)
+			return i;
+
+	return nullptr;
+}
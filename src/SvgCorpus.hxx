@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "Compiler.h"
+
+#include <stdio.h>
+
+/**
+ * A class of synthetic SVG documents, each stressing a different
+ * part of the converter.
+ */
+struct SvgCorpusClass {
+	const char *name;
+	const char *description;
+
+	/**
+	 * Write a document to the given file.  The output depends only
+	 * on #scale, which multiplies the number of elements (or, for
+	 * "huge", the length of the path data).
+	 */
+	void (*generate)(FILE *file, unsigned scale);
+};
+
+/**
+ * All classes; terminated by an entry with #name == nullptr.
+ */
+extern const SvgCorpusClass svg_corpus_classes[];
+
+gcc_pure
+const SvgCorpusClass *
+FindSvgCorpusClass(const char *name) noexcept;
@@ -21,9 +21,11 @@
 
 #include "Color.hxx"
 
+#include <algorithm>
 #include <vector>
 
 #include <math.h>
+#include <stdint.h>
 
 struct SvgPoint {
 	double x, y;
@@ -82,11 +84,117 @@ struct SvgVertex : SvgPoint {
 	constexpr SvgVertex(Type _type, double _x, double _y):SvgPoint(_x, _y), type(_type) {}
 };
 
+/**
+ * A vertex of the final (transformed) geometry in 8 bytes instead of
+ * 24: fixed point numbers with a resolution of 1/64 SVG unit (about
+ * 0.004 mm, far below the PES resolution of 0.1 mm), and the "move"
+ * flag in bit 0 of #x.
+ *
+ * The range is limited to #LIMIT, which is far beyond any hoop;
+ * check CanRepresent() before converting.
+ */
+struct SvgCompactVertex {
+	int32_t x, y;
+
+	/**
+	 * Coordinates must be smaller than this (in absolute value).
+	 * With 1/128 units, #x would overflow at 2^24.
+	 */
+	static constexpr double LIMIT = 1 << 23;
+
+	SvgCompactVertex() = default;
+
+	explicit SvgCompactVertex(const SvgVertex &v) noexcept
+		:x(int32_t(lround(v.x * 64) * 2) |
+		   (v.type == SvgVertex::Type::MOVE)),
+		 y(int32_t(lround(v.y * 64))) {}
+
+	/**
+	 * Can the given point be stored?  False for non-finite
+	 * coordinates, too.
+	 */
+	static constexpr bool CanRepresent(SvgPoint p) noexcept {
+		return p.x > -LIMIT && p.x < LIMIT &&
+			p.y > -LIMIT && p.y < LIMIT;
+	}
+
+	bool IsMove() const noexcept {
+		return x & 1;
+	}
+
+	double GetX() const noexcept {
+		return (x & ~1) * (1. / 128);
+	}
+
+	double GetY() const noexcept {
+		return y * (1. / 64);
+	}
+
+	SvgPoint GetPoint() const noexcept {
+		return {GetX(), GetY()};
+	}
+};
+
+/**
+ * An axis-aligned bounding box.  A default-constructed box is empty.
+ */
+struct SvgBox {
+	SvgPoint min{INFINITY, INFINITY}, max{-INFINITY, -INFINITY};
+
+	SvgBox() = default;
+	constexpr SvgBox(SvgPoint _min, SvgPoint _max)
+		:min(_min), max(_max) {}
+
+	void Extend(SvgPoint p) noexcept {
+		min.x = std::min(min.x, p.x);
+		min.y = std::min(min.y, p.y);
+		max.x = std::max(max.x, p.x);
+		max.y = std::max(max.y, p.y);
+	}
+
+	/**
+	 * Extend by all points within the given distance of #p.
+	 */
+	void Extend(SvgPoint p, double margin) noexcept {
+		Extend(p - SvgPoint(margin, margin));
+		Extend(p + SvgPoint(margin, margin));
+	}
+
+	/**
+	 * Do the two boxes have at least one point in common?  Always
+	 * false if one of them is empty.
+	 */
+	constexpr bool Overlaps(const SvgBox &other) const noexcept {
+		return min.x <= other.max.x && other.min.x <= max.x &&
+			min.y <= other.max.y && other.min.y <= max.y;
+	}
+};
+
+/**
+ * How to determine the inside of a filled shape; see
+ * https://www.w3.org/TR/SVG/painting.html#FillRuleProperty
+ */
+enum class SvgFillRule {
+	NONZERO,
+	EVENODD,
+};
+
 struct SvgPath {
-	std::vector<SvgVertex> points;
+	/**
+	 * The outline after all transformations.
+	 */
+	std::vector<SvgCompactVertex> points;
 
 	Color fill_color, stroke_color;
 
+	/**
+	 * The nearest entries in the PES color table, resolved along
+	 * with the style.
+	 */
+	unsigned fill_pes_color = 0, stroke_pes_color = 0;
+
+	SvgFillRule fill_rule = SvgFillRule::NONZERO;
+
 	bool fill = false, stroke = false;
 };
 
@@ -49,6 +49,19 @@ struct SvgMatrix {
 			values[1][0] * p.x + values[1][1] * p.y + values[1][2],
 		};
 	}
+
+	/**
+	 * Transform a box; the result is the bounding box of the
+	 * transformed corners.
+	 */
+	SvgBox operator*(const SvgBox &box) const noexcept {
+		SvgBox result;
+		result.Extend(*this * box.min);
+		result.Extend(*this * SvgPoint(box.max.x, box.min.y));
+		result.Extend(*this * SvgPoint(box.min.x, box.max.y));
+		result.Extend(*this * box.max);
+		return result;
+	}
 };
 
 #endif
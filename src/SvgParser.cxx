@@ -18,23 +18,39 @@
 
 #include "SvgParser.hxx"
 #include "SvgData.hxx"
-#include "SvgMatrix.hxx"
+#include "SvgTransform.hxx"
 #include "SvgArc.hxx"
 #include "SvgBezier.hxx"
-#include "CssColor.hxx"
-#include "CssParser.hxx"
+#include "SvgStyle.hxx"
+#include "ResourceBudget.hxx"
+#include "Trace.hxx"
+#include "MemoryStats.hxx"
 #include "ExpatUtil.hxx"
 #include "util/StringUtil.hxx"
 
 #include <stdexcept>
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 #include <math.h>
 
-SvgParser::SvgParser() = default;
+SvgParser::SvgParser()
+	:CommonExpatParser(false) {}
 SvgParser::~SvgParser() noexcept = default;
 
+void
+SvgParser::SetBudget(ResourceBudget &_budget)
+{
+	budget = &_budget;
+
+	const float max_amplification =
+		budget->GetLimits().max_amplification;
+	if (max_amplification > 0 &&
+	    !SetMaxAmplification(max_amplification))
+		throw std::runtime_error("This Expat version cannot limit the amplification");
+}
+
 static bool
 ParseFlag(const char *&d)
 {
@@ -69,13 +85,30 @@ ParseDouble(const char *&d)
 {
 	char *endptr;
 	double value = strtod(d, &endptr);
-	if (endptr == d)
+	if (endptr == d || !isfinite(value))
 		throw std::runtime_error("Malformed number");
 
 	d = StripLeft(endptr);
 	return value;
 }
 
+/**
+ * Parse a numeric attribute.  Unlike plain strtod(), this rejects
+ * "inf", "nan" and values which overflow.
+ */
+static double
+ParseNumberAttribute(const char *s, double default_value=0)
+{
+	if (s == nullptr)
+		return default_value;
+
+	double value = strtod(s, nullptr);
+	if (!isfinite(value))
+		throw std::runtime_error("Malformed number");
+
+	return value;
+}
+
 static SvgPoint
 ParsePoint(const SvgPoint cursor, bool relative, const char *&d)
 {
@@ -119,9 +152,73 @@ ParseVertical(const SvgPoint cursor, bool relative, const char *&d)
 	return p;
 }
 
-class SvgPathParser : public SvgPath {
+/**
+ * A path segment with absolute coordinates, as parsed from the "d"
+ * attribute.  Flattening is postponed until culling has decided
+ * whether the path is needed at all.
+ */
+struct SvgPathSegment {
+	enum class Type : uint8_t {
+		MOVE,
+		LINE,
+		ARC,
+		QUADRATIC_CURVE,
+		CUBIC_CURVE,
+	} type;
+
+	bool large_arc, sweep;
+
+	/**
+	 * The rotation of an arc's x axis [degrees].
+	 */
+	double rotation;
+
+	/**
+	 * The control points of a curve; #p1 is the radius of an arc.
+	 */
+	SvgPoint p1, p2;
+
+	SvgPoint end;
+};
+
+/**
+ * Extend the box by a generous hull of an elliptical arc: no point of
+ * the arc is farther from the start point than the ellipse's
+ * diameter, even after the radius has been adjusted to reach the end
+ * point and after undoing the aspect ratio correction.
+ *
+ * @return false if no bound is known (degenerate radius)
+ */
+static bool
+ExtendArcHull(SvgBox &hull, SvgPoint start, SvgPoint radius, SvgPoint end)
+{
+	const double r_min = std::min(fabs(radius.x), fabs(radius.y));
+	const double r_max = std::max(fabs(radius.x), fabs(radius.y));
+	if (!(r_min > 0))
+		return false;
+
+	const double distance = sqrt((end - start).SquareMagnitude());
+	hull.Extend(start, (r_max + distance) * (r_max / r_min) + r_max);
+	hull.Extend(end);
+	return true;
+}
+
+class SvgPathParser {
+	std::vector<SvgPathSegment> segments;
+
+	/**
+	 * The bounding box of all end and control points.
+	 */
+	SvgBox hull;
+
 	SvgPoint cursor{0, 0};
 
+	/**
+	 * False if the path contains an arc which makes #hull
+	 * meaningless.
+	 */
+	bool bounded = true;
+
 	enum class Type {
 		MOVE,
 		LINE,
@@ -135,26 +232,49 @@ class SvgPathParser : public SvgPath {
 public:
 	void Parse(const char *d);
 
+	/**
+	 * Does #hull enclose the whole path?
+	 */
+	bool IsBounded() const {
+		return bounded;
+	}
+
+	const SvgBox &GetHull() const {
+		return hull;
+	}
+
+	/**
+	 * Convert the segments to line vertices.
+	 *
+	 * @param budget if not nullptr, the vertices are accounted
+	 * here after each segment
+	 * @return the number of curves and arcs
+	 */
+	unsigned long Flatten(std::vector<SvgVertex> &dest,
+		     ResourceBudget *budget) const;
+
 private:
+	void Append(SvgPathSegment::Type type, SvgPoint end) {
+		segments.push_back({type, false, false, 0, {}, {}, end});
+		hull.Extend(end);
+		cursor = end;
+	}
+
 	void ParseVertex(Type type, bool relative, const char *&d);
 };
 
 inline void
 SvgPathParser::ParseVertex(Type type, bool relative, const char *&d)
 {
-	SvgPoint p;
-
 	switch (type) {
 	case Type::MOVE:
-		points.emplace_back(SvgVertex::Type::MOVE,
-				    ParsePoint(cursor, relative, d));
-		cursor = points.back();
+		Append(SvgPathSegment::Type::MOVE,
+		       ParsePoint(cursor, relative, d));
 		break;
 
 	case Type::LINE:
-		points.emplace_back(SvgVertex::Type::LINE,
-				    ParsePoint(cursor, relative, d));
-		cursor = points.back();
+		Append(SvgPathSegment::Type::LINE,
+		       ParsePoint(cursor, relative, d));
 		break;
 
 	case Type::ARC:
@@ -177,12 +297,14 @@ SvgPathParser::ParseVertex(Type type, bool relative, const char *&d)
 
 			SvgPoint end = ParsePoint(cursor, relative, d);
 
-			SvgArcToLines(*this, cursor, radius, rotation,
-				      large_arc, sweep,
-				      end);
-		}
+			if (!ExtendArcHull(hull, cursor, radius, end))
+				bounded = false;
 
-		cursor = points.back();
+			segments.push_back({SvgPathSegment::Type::ARC,
+					    large_arc, sweep, rotation,
+					    radius, {}, end});
+			cursor = end;
+		}
 
 		break;
 
@@ -191,10 +313,14 @@ SvgPathParser::ParseVertex(Type type, bool relative, const char *&d)
 			const auto control = ParsePoint(cursor, relative, d);
 			const auto end = ParsePoint(cursor, relative, d);
 
-			SvgQuadraticBezierToLines(*this, cursor, control, end);
+			hull.Extend(control);
+			hull.Extend(end);
+			segments.push_back({SvgPathSegment::Type::QUADRATIC_CURVE,
+					    false, false, 0,
+					    control, {}, end});
+			cursor = end;
 		}
 
-		cursor = points.back();
 		break;
 
 	case Type::CUBIC_CURVE:
@@ -203,26 +329,28 @@ SvgPathParser::ParseVertex(Type type, bool relative, const char *&d)
 			const auto control2 = ParsePoint(cursor, relative, d);
 			const auto end = ParsePoint(cursor, relative, d);
 
-			SvgCubicBezierToLines(*this, cursor,
-					      control1, control2, end);
+			hull.Extend(control1);
+			hull.Extend(control2);
+			hull.Extend(end);
+			segments.push_back({SvgPathSegment::Type::CUBIC_CURVE,
+					    false, false, 0,
+					    control1, control2, end});
+			cursor = end;
 		}
 
-		cursor = points.back();
 		break;
 
 	case Type::SMOOTH_QUADRATIC_CURVE:
 		// TODO: implement
-		points.emplace_back(SvgVertex::Type::LINE,
-				    ParsePoint(cursor, relative, d));
-		cursor = points.back();
+		Append(SvgPathSegment::Type::LINE,
+		       ParsePoint(cursor, relative, d));
 		break;
 
 	case Type::SMOOTH_CUBIC_CURVE:
 		// TODO: implement
 		ParsePoint(cursor, relative, d);
-		points.emplace_back(SvgVertex::Type::LINE,
-				    ParsePoint(cursor, relative, d));
-		cursor = points.back();
+		Append(SvgPathSegment::Type::LINE,
+		       ParsePoint(cursor, relative, d));
 		break;
 	}
 }
@@ -322,39 +450,35 @@ SvgPathParser::Parse(const char *d)
 
 		case 'H':
 			++d;
-			points.emplace_back(SvgVertex::Type::LINE,
-					    ParseHorizontal(cursor, false, d));
-			cursor = points.back();
+			Append(SvgPathSegment::Type::LINE,
+			       ParseHorizontal(cursor, false, d));
 			break;
 
 		case 'h':
 			++d;
-			points.emplace_back(SvgVertex::Type::LINE,
-					    ParseHorizontal(cursor, true, d));
-			cursor = points.back();
+			Append(SvgPathSegment::Type::LINE,
+			       ParseHorizontal(cursor, true, d));
 			break;
 
 		case 'V':
 			++d;
-			points.emplace_back(SvgVertex::Type::LINE,
-					    ParseVertical(cursor, false, d));
-			cursor = points.back();
+			Append(SvgPathSegment::Type::LINE,
+			       ParseVertical(cursor, false, d));
 			break;
 
 		case 'v':
 			++d;
-			points.emplace_back(SvgVertex::Type::LINE,
-					    ParseVertical(cursor, true, d));
-			cursor = points.back();
+			Append(SvgPathSegment::Type::LINE,
+			       ParseVertical(cursor, true, d));
 			break;
 
 		case 'z':
 		case 'Z':
-			if (sub_start < points.size())
-				points.emplace_back(SvgVertex::Type::LINE,
-						    points[sub_start]);
+			if (sub_start < segments.size())
+				Append(SvgPathSegment::Type::LINE,
+				       segments[sub_start].end);
 
-			sub_start = points.size();
+			sub_start = segments.size();
 			++d;
 			break;
 
@@ -364,55 +488,118 @@ SvgPathParser::Parse(const char *d)
 	}
 }
 
-inline SvgParser::PathList::iterator
+unsigned long
+SvgPathParser::Flatten(std::vector<SvgVertex> &dest,
+		       ResourceBudget *budget) const
+{
+	SvgPoint start{0, 0};
+	unsigned long n_curves = 0;
+
+	for (const auto &i : segments) {
+		const size_t old_size = dest.size();
+
+		switch (i.type) {
+		case SvgPathSegment::Type::MOVE:
+			dest.emplace_back(SvgVertex::Type::MOVE, i.end);
+			break;
+
+		case SvgPathSegment::Type::LINE:
+			dest.emplace_back(SvgVertex::Type::LINE, i.end);
+			break;
+
+		case SvgPathSegment::Type::ARC:
+			SvgArcToLines(dest, start, i.p1, i.rotation,
+				      i.large_arc, i.sweep, i.end);
+			++n_curves;
+			break;
+
+		case SvgPathSegment::Type::QUADRATIC_CURVE:
+			SvgQuadraticBezierToLines(dest, start, i.p1, i.end);
+			++n_curves;
+			break;
+
+		case SvgPathSegment::Type::CUBIC_CURVE:
+			SvgCubicBezierToLines(dest, start, i.p1, i.p2, i.end);
+			++n_curves;
+			break;
+		}
+
+		start = i.end;
+
+		if (budget != nullptr)
+			budget->AddVertices(dest.size() - old_size);
+	}
+
+	return n_curves;
+}
+
+inline bool
+SvgParser::IsCulled(const SvgBox &box) const
+{
+	if (!cull)
+		return false;
+
+	const auto &group = groups.front();
+	return !canvas.Overlaps(group.transformed ? group.matrix * box : box);
+}
+
+inline bool
 SvgParser::ParsePath(const char *d)
 {
 	SvgPathParser pp;
 	pp.Parse(d);
-	paths.emplace_front(std::move(pp));
-	return paths.begin();
+	if (pp.IsBounded() && IsCulled(pp.GetHull()))
+		return false;
+
+	stats.curves += pp.Flatten(polyline, budget);
+	return true;
 }
 
-inline SvgParser::PathList::iterator
+inline bool
 SvgParser::ParseRect(const char *_x, const char *_y,
 		     const char *_width, const char *_height)
 {
 	if (_width == nullptr && _height == nullptr)
-		return paths.end();
+		return false;
 
-	double x = _x != nullptr ? strtod(_x, nullptr) : 0;
-	double y = _y != nullptr ? strtod(_y, nullptr) : 0;
-	double width = strtod(_width, nullptr);
-	double height = strtod(_height, nullptr);
+	double x = ParseNumberAttribute(_x);
+	double y = ParseNumberAttribute(_y);
+	double width = ParseNumberAttribute(_width);
+	double height = ParseNumberAttribute(_height);
 	if (width <= 0 || height <= 0)
-		return paths.end();
+		return false;
 
-	paths.emplace_front();
-	auto &points = paths.front().points;
-	points.reserve(5);
+	if (IsCulled(SvgBox({x, y}, {x + width, y + height})))
+		return false;
+
+	auto &points = polyline;
 	points.emplace_back(SvgVertex::Type::MOVE, x, y);
 	points.emplace_back(SvgVertex::Type::LINE, x + width, y);
 	points.emplace_back(SvgVertex::Type::LINE, x + width, y + height);
 	points.emplace_back(SvgVertex::Type::LINE, x, y + height);
 	points.emplace_back(SvgVertex::Type::LINE, x, y);
-	return paths.begin();
+
+	if (budget != nullptr)
+		budget->AddVertices(points.size());
+	return true;
 }
 
-inline SvgParser::PathList::iterator
+inline bool
 SvgParser::ParseCircle(const char *_cx, const char *_cy, const char *_r)
 {
 	if (_r == nullptr)
-		return paths.end();
+		return false;
 
-	double cx = _cx != nullptr ? strtod(_cx, nullptr) : 0;
-	double cy = _cy != nullptr ? strtod(_cy, nullptr) : 0;
-	double r = strtod(_r, nullptr);
+	double cx = ParseNumberAttribute(_cx);
+	double cy = ParseNumberAttribute(_cy);
+	double r = ParseNumberAttribute(_r);
 	if (r <= 0)
-		return paths.end();
+		return false;
 
-	paths.emplace_front();
-	auto &points = paths.front().points;
-	points.reserve(5);
+	if (IsCulled(SvgBox({cx - r, cy - r}, {cx + r, cy + r})))
+		return false;
+
+	auto &points = polyline;
 	points.emplace_back(SvgVertex::Type::MOVE, cx + r, cy);
 
 	for (double angle = 0.03; angle < 2 * M_PI; angle += 0.06)
@@ -422,219 +609,252 @@ SvgParser::ParseCircle(const char *_cx, const char *_cy, const char *_r)
 
 	points.emplace_back(SvgVertex::Type::LINE, cx + r, cy);
 
-	return paths.begin();
+	if (budget != nullptr)
+		budget->AddVertices(points.size());
+	return true;
 }
 
 namespace {
 
-void
-ApplyStroke(SvgPath &path, const char *stroke)
+/**
+ * Does this element never contain rendered geometry (or none which
+ * svg2pes can use)?  Its subtree is skipped without looking at it.
+ */
+gcc_pure
+bool
+IsIgnoredElement(const char *name) noexcept
 {
-	if (strcmp(stroke, "none") == 0) {
-		path.stroke = false;
-		return;
-	}
+	static constexpr const char *ignored[] = {
+		"metadata", "sodipodi:namedview", "title", "desc",
+		"text", "image", "script", "foreignObject",
+		"symbol", "clipPath", "mask", "pattern", "marker",
+		"linearGradient", "radialGradient", "filter",
+	};
+
+	for (const char *i : ignored)
+		if (strcmp(name, i) == 0)
+			return true;
 
-	path.stroke_color = ParseCssColor(stroke);
-	path.stroke = true;
+	return false;
 }
 
-void
-ApplyFill(SvgPath &path, const char *fill)
+/**
+ * Parse the viewport of the outermost "svg" element in user units.
+ * Lengths with units other than "px" are not supported.
+ *
+ * @return false if there is none
+ */
+bool
+ParseCanvas(SvgBox &canvas, const XML_Char **atts)
 {
-	if (strcmp(fill, "none") == 0) {
-		path.fill = false;
-		return;
+	try {
+		const char *view_box = FindXmlAttribute(atts, "viewBox");
+		if (view_box != nullptr) {
+			const char *p = StripLeft(view_box);
+			double values[4];
+			for (auto &i : values) {
+				i = ParseDouble(p);
+				if (*p == ',')
+					p = StripLeft(p + 1);
+			}
+
+			if (values[2] <= 0 || values[3] <= 0)
+				return false;
+
+			canvas = SvgBox({values[0], values[1]},
+					{values[0] + values[2],
+					 values[1] + values[3]});
+			return true;
+		}
+	} catch (...) {
+		return false;
 	}
 
-	path.fill_color = ParseCssColor(fill);
-	path.fill = true;
+	const char *width = FindXmlAttribute(atts, "width");
+	const char *height = FindXmlAttribute(atts, "height");
+	if (width == nullptr || height == nullptr)
+		return false;
+
+	char *endptr;
+	const double w = strtod(width, &endptr);
+	if (*endptr != 0 && strcmp(endptr, "px") != 0)
+		return false;
+
+	const double h = strtod(height, &endptr);
+	if (*endptr != 0 && strcmp(endptr, "px") != 0)
+		return false;
+
+	if (!(w > 0 && h > 0) || !isfinite(w) || !isfinite(h))
+		return false;
+
+	canvas = SvgBox({0, 0}, {w, h});
+	return true;
+}
+
+void
+Transform(std::vector<SvgVertex> &polyline, const SvgMatrix &matrix)
+{
+	for (auto &i : polyline)
+		(SvgPoint &)i = matrix * i;
 }
 
 } // anonymous namespace
 
 void
-SvgParser::ApplyPathAttributes(SvgPath &path, const XML_Char **atts)
+SvgParser::StartElement(const XML_Char *name, const XML_Char **atts)
 {
-	const char *style = FindXmlAttribute(atts, "style");
-	if (style != nullptr) {
-		try {
-			auto css = ParseCss(style);
-			auto i = css.find("stroke");
-			if (i != css.end())
-				ApplyStroke(path, i->second.c_str());
-
-			i = css.find("fill");
-			if (i != css.end())
-				ApplyFill(path, i->second.c_str());
-		} catch (...) {
-			fprintf(stderr, "Failed to parse CSS '%s'\n", style);
-		}
+	++stats.elements;
+
+	if (IsIgnoredElement(name) ||
+	    (!groups.empty() && groups.front().defs &&
+	     strcmp(name, "style") != 0)) {
+		SkipElement();
+		return;
 	}
 
-	const char *stroke = FindXmlAttribute(atts, "stroke");
-	if (stroke != nullptr) {
-		try {
-			ApplyStroke(path, stroke);
-		} catch (...) {
-			fprintf(stderr, "Failed to parse color '%s'\n", stroke);
+	if (strcmp(name, "style") == 0) {
+		const char *type = FindXmlAttribute(atts, "type");
+		if (type != nullptr && strcmp(type, "text/css") != 0) {
+			SkipElement();
+			return;
 		}
+
+		/* collect the style sheet until the end tag */
+		in_style = true;
+		SetCharacterDataEnabled(true);
+		groups.emplace_front();
+		++depth;
+
+		if (IsTraceEnabled())
+			TraceBegin("element", name, nullptr);
+		return;
 	}
 
-	const char *fill = FindXmlAttribute(atts, "fill");
-	if (fill != nullptr) {
-		try {
-			ApplyFill(path, fill);
-		} catch (...) {
-			fprintf(stderr, "Failed to parse color '%s'\n", fill);
-		}
+	const SvgStyle &style = [&]() -> const SvgStyle & {
+		const ScopeMemorySubsystem scope(MemorySubsystem::STYLES);
+		return styles.Get(name, atts, stylesheet);
+	}();
+	if (style.hidden) {
+		SkipElement();
+		return;
 	}
-}
 
-void
-SvgParser::StartElement(const XML_Char *name, const XML_Char **atts)
-{
+	if (groups.empty()) {
+		if (culling && strcmp(name, "svg") == 0)
+			cull = ParseCanvas(canvas, atts);
+
+		groups.emplace_front();
+	} else
+		groups.emplace_front(groups.front());
+
+	++depth;
+	if (budget != nullptr) {
+		budget->CheckDepth(depth);
+		budget->CheckTime();
+	}
+
+	/* the span lasts until the end tag, so a group's span
+	   includes its children */
+	if (IsTraceEnabled())
+		TraceBegin("element", name, FindXmlAttribute(atts, "id"));
+
+	auto &group = groups.front();
+	if (strcmp(name, "defs") == 0) {
+		group.defs = true;
+		return;
+	}
+
+	if (style.visibility != SvgVisibility::INHERIT)
+		group.visible = style.visibility == SvgVisibility::VISIBLE;
+
 	const char *transform = FindXmlAttribute(atts, "transform");
-	if (transform == nullptr)
-		transform = "";
+	if (transform != nullptr) {
+		const ScopeMemorySubsystem scope(MemorySubsystem::STYLES);
+		group.matrix *= transforms.Get(transform);
+		group.transformed = true;
+	}
+
+	if (!group.visible)
+		return;
+
+	const ScopeMemorySubsystem memory_scope(MemorySubsystem::PATHS);
+	TraceSpan span("shape", name);
 
-	groups.emplace_front(transform, paths.begin());
+	polyline.clear();
 
-	auto path = paths.end();
+	bool found = false;
 	if (strcmp(name, "path") == 0) {
 		const char *d = FindXmlAttribute(atts, "d");
 		if (d != nullptr)
-			path = ParsePath(d);
+			found = ParsePath(d);
 	} else if (strcmp(name, "rect") == 0) {
 		const char *x = FindXmlAttribute(atts, "x");
 		const char *y = FindXmlAttribute(atts, "y");
 		const char *width = FindXmlAttribute(atts, "width");
 		const char *height = FindXmlAttribute(atts, "height");
-		path = ParseRect(x, y, width, height);
+		found = ParseRect(x, y, width, height);
 	} else if (strcmp(name, "circle") == 0) {
 		const char *cx = FindXmlAttribute(atts, "cx");
 		const char *cy = FindXmlAttribute(atts, "cy");
 		const char *r = FindXmlAttribute(atts, "r");
-		path = ParseCircle(cx, cy, r);
-	}
-
-	if (path != paths.end())
-		ApplyPathAttributes(*path, atts);
-}
-
-class SvgTransform {
-	SvgMatrix matrix;
-
-public:
-	void Parse(const char *p);
-
-	void Apply(SvgPath &path) {
-		for (auto &i : path.points)
-			(SvgPoint &)i = matrix * i;
-	}
-};
-
-static const char *
-ParseMatrix(SvgMatrix &m, const char *p)
-{
-	for (unsigned x = 0; x < 3; ++x) {
-		for (unsigned y = 0; y < 2; ++y) {
-			m.values[y][x] = ParseDouble(p);
-			if (*p == ',')
-				++p;
-		}
+		found = ParseCircle(cx, cy, r);
 	}
 
-	if (*p != ')')
-		throw std::runtime_error("')' expected");
-
-	return p + 1;
-}
-
-static const char *
-ParseTranslate(SvgMatrix &m, const char *p)
-{
-	m.values[0][2] = ParseDouble(p);
-	if (*p == ',')
-		++p;
+	if (!found)
+		return;
 
-	if (*p != ')')
-		m.values[1][2] = ParseDouble(p);
+	if (group.transformed)
+		Transform(polyline, group.matrix);
 
-	if (*p != ')')
-		throw std::runtime_error("')' expected");
+	/* don't let SvgCompactVertex wrap around */
+	for (const auto &i : polyline)
+		if (!SvgCompactVertex::CanRepresent(i))
+			throw std::runtime_error("Coordinates out of range");
 
-	return p + 1;
-}
-
-static const char *
-ParseScale(SvgMatrix &m, const char *p)
-{
-	m.values[0][0] = m.values[1][1] = ParseDouble(p);
-	if (*p == ',')
-		++p;
+	paths.emplace_front();
+	auto &path = paths.front();
 
-	if (*p != ')')
-		m.values[1][1] = ParseDouble(p);
+	++stats.paths;
+	stats.vertices += polyline.size();
+	span.SetCount(polyline.size());
 
-	if (*p != ')')
-		throw std::runtime_error("')' expected");
+	path.points.reserve(polyline.size());
+	for (const auto &i : polyline)
+		path.points.emplace_back(i);
 
-	return p + 1;
-}
+	style.ApplyTo(path);
 
-inline void
-SvgTransform::Parse(const char *p)
-{
-	while (*(p = StripLeft(p)) != 0) {
-		const char *q;
-		if ((q = StringAfterPrefix(p, "matrix(")) != nullptr) {
-			SvgMatrix m;
-			p = ParseMatrix(m, q);
-			matrix = m * matrix;
-		} else if ((q = StringAfterPrefix(p, "translate(")) != nullptr) {
-			SvgMatrix m;
-			p = ParseTranslate(m, q);
-			matrix = m * matrix;
-		} else if ((q = StringAfterPrefix(p, "scale(")) != nullptr) {
-			SvgMatrix m;
-			p = ParseScale(m, q);
-			matrix = m * matrix;
-		} else {
-			throw std::runtime_error("Failed to parse transform");
-		}
+	if (path_handler != nullptr) {
+		path_handler->OnSvgPath(std::move(path));
+		paths.pop_front();
 	}
 }
 
-template<typename I>
-static void
-ApplyTransform(const char *_transform, I begin, I end)
-{
-	if (*_transform == 0)
-		return;
-
-	SvgTransform transform;
-	transform.Parse(_transform);
-
-	for (I i = begin; i != end; ++i)
-		transform.Apply(*i);
-}
-
 void
 SvgParser::EndElement(const XML_Char *name)
 {
 	(void)name;
 
 	assert(!groups.empty());
-
-	ApplyTransform(groups.front().transform.c_str(),
-		       paths.begin(), groups.front().end);
 	groups.pop_front();
+	--depth;
+
+	if (in_style) {
+		/* rules apply to all following elements */
+		in_style = false;
+		SetCharacterDataEnabled(false);
+		const ScopeMemorySubsystem scope(MemorySubsystem::STYLES);
+		stylesheet.Parse(style_text.c_str());
+		style_text.clear();
+	}
+
+	if (IsTraceEnabled())
+		TraceEnd("element");
 }
 
 void
 SvgParser::CharacterData(const XML_Char *s, int len)
 {
-	(void)s;
-	(void)len;
+	if (in_style)
+		style_text.append(s, len);
 }
@@ -20,44 +20,194 @@
 #define SVG_PARSER_HXX
 
 #include "ExpatParser.hxx"
+#include "SvgTransform.hxx"
+#include "SvgStyle.hxx"
+#include "CssStylesheet.hxx"
+#include "Compiler.h"
 
 #include <forward_list>
 
-struct SvgPath;
+class ResourceBudget;
+
+/**
+ * Counters collected by #SvgParser.
+ */
+struct SvgParserStats {
+	/**
+	 * The number of elements which were looked at (not counting
+	 * skipped subtrees).
+	 */
+	unsigned long elements = 0;
+
+	/**
+	 * The number of paths which were generated.
+	 */
+	unsigned long paths = 0;
+
+	/**
+	 * The number of vertices of all paths.
+	 */
+	unsigned long vertices = 0;
+
+	/**
+	 * The number of curves and arcs which were flattened.
+	 */
+	unsigned long curves = 0;
+};
+
+/**
+ * Receives the paths of a document while it is being parsed.
+ */
+class SvgPathHandler {
+public:
+	/**
+	 * A path has been parsed; they are passed in document order.
+	 */
+	virtual void OnSvgPath(SvgPath &&path) = 0;
+};
 
 class SvgParser final : public CommonExpatParser {
 	typedef std::forward_list<SvgPath> PathList;
 	PathList paths;
 
 	struct Group {
-		std::string transform;
-		PathList::iterator end;
+		/**
+		 * The transformation from this element's coordinate
+		 * system to the document's.
+		 */
+		SvgMatrix matrix;
+
+		/**
+		 * Does this element or one of its ancestors have a
+		 * "transform" attribute?  If not, #matrix is the identity
+		 * and applying it can be skipped.
+		 */
+		bool transformed = false;
+
+		/**
+		 * The inherited "visibility" property.
+		 */
+		bool visible = true;
 
-		Group(const char *_transform, PathList::iterator _end)
-			:transform(_transform), end(_end) {}
+		/**
+		 * Is this a "defs" element?  Only "style" children are
+		 * evaluated.
+		 */
+		bool defs = false;
 	};
 
 	std::forward_list<Group> groups;
 
+	SvgTransformCache transforms;
+
+	/**
+	 * The outline of the current element in full precision.  It
+	 * is converted to the compact #SvgPath representation after
+	 * transformation.  A member to avoid reallocating it for each
+	 * element.
+	 */
+	std::vector<SvgVertex> polyline;
+
+	CssStylesheet stylesheet;
+	SvgStyleCache styles;
+
+	/**
+	 * Inside a "style" element?  Then #style_text collects its
+	 * contents.
+	 */
+	bool in_style = false;
+	std::string style_text;
+
+	/**
+	 * Elements entirely outside of this box (in document
+	 * coordinates) are discarded.  It is the viewport of the
+	 * outermost "svg" element.
+	 */
+	SvgBox canvas;
+
+	/**
+	 * Cull elements outside of #canvas?
+	 */
+	bool culling = true, cull = false;
+
+	/**
+	 * If set, paths are passed to this object instead of being
+	 * stored in #paths.
+	 */
+	SvgPathHandler *path_handler = nullptr;
+
+	ResourceBudget *budget = nullptr;
+
+	SvgParserStats stats;
+
+	/**
+	 * The number of entries in #groups.
+	 */
+	unsigned depth = 0;
+
 public:
 	SvgParser();
 	~SvgParser() noexcept;
 
+	/**
+	 * Keep elements outside of the document's viewport.  Must be
+	 * called before parsing.
+	 */
+	void DisableCulling() {
+		culling = false;
+	}
+
+	/**
+	 * Pass each path to the given handler as soon as it has been
+	 * parsed instead of collecting them, so the memory needed
+	 * does not depend on the size of the document.  Must be
+	 * called before parsing.
+	 */
+	void SetPathHandler(SvgPathHandler &_handler) {
+		path_handler = &_handler;
+	}
+
+	/**
+	 * Enforce the limits of the given budget while parsing.  Must
+	 * be called before parsing.
+	 */
+	void SetBudget(ResourceBudget &_budget);
+
+	/**
+	 * Limit the memory used by each of the caches for "style"
+	 * and "transform" attributes, which would otherwise grow with
+	 * the number of distinct values in the document.
+	 */
+	void SetCacheLimit(size_t max_size) {
+		transforms.SetMaxSize(max_size);
+		styles.SetMaxSize(max_size);
+	}
+
+	const SvgParserStats &GetStats() const {
+		return stats;
+	}
+
+	/**
+	 * Returns the paths in reverse document order.  Empty if a
+	 * #SvgPathHandler was set.
+	 */
 	const PathList &GetPaths() const {
 		return paths;
 	}
 
 private:
-	void BeginTransform(const char *transform);
-	void EndTransform();
-
-	PathList::iterator ParsePath(const char *d);
-	PathList::iterator ParseRect(const char *x, const char *y,
-				     const char *width, const char *height);
-	PathList::iterator ParseCircle(const char *cx, const char *cy,
-				       const char *r);
+	gcc_pure
+	bool IsCulled(const SvgBox &box) const;
 
-	void ApplyPathAttributes(SvgPath &path, const XML_Char **atts);
+	/*
+	 * These methods tessellate the shape into #polyline.
+	 *
+	 * @return false if there is nothing to be drawn
+	 */
+	bool ParsePath(const char *d);
+	bool ParseRect(const char *x, const char *y,
+		       const char *width, const char *height);
+	bool ParseCircle(const char *cx, const char *cy, const char *r);
 
 protected:
 	void StartElement(const XML_Char *name,
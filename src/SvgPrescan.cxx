@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SvgPrescan.hxx"
+
+#include <string.h>
+
+/* the number of vertices generated for each kind of segment; see
+   SvgArcToLines(), SvgCubicBezierToLines() and
+   SvgParser::ParseCircle() */
+static constexpr unsigned CURVE_VERTICES = 17;
+static constexpr unsigned ARC_VERTICES = 34;
+static constexpr unsigned CIRCLE_VERTICES = 107;
+static constexpr unsigned RECT_VERTICES = 5;
+
+static constexpr bool
+IsWhitespace(char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static constexpr bool
+IsDigit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+static constexpr bool
+IsNameChar(char ch)
+{
+	return !IsWhitespace(ch) && ch != '/' && ch != '>' && ch != '=';
+}
+
+static bool
+StartsWith(const char *p, const char *end, const char *prefix)
+{
+	const size_t length = strlen(prefix);
+	return size_t(end - p) >= length && memcmp(p, prefix, length) == 0;
+}
+
+/**
+ * Skip to the end of the given string.
+ *
+ * @return the position after it, or #end if it was not found
+ */
+static const char *
+SkipPast(const char *p, const char *end, const char *needle)
+{
+	const size_t length = strlen(needle);
+	const void *q = memmem(p, end - p, needle, length);
+	return q != nullptr ? (const char *)q + length : end;
+}
+
+static const char *
+SkipNumber(const char *p, const char *end)
+{
+	if (p < end && (*p == '-' || *p == '+'))
+		++p;
+
+	while (p < end && IsDigit(*p))
+		++p;
+
+	if (p < end && *p == '.')
+		for (++p; p < end && IsDigit(*p);)
+			++p;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		if (p < end && (*p == '-' || *p == '+'))
+			++p;
+		while (p < end && IsDigit(*p))
+			++p;
+	}
+
+	return p;
+}
+
+/**
+ * Look up the number of arguments and the resulting vertices of a
+ * path command.
+ *
+ * @return false if this is not a path command
+ */
+static bool
+LookupPathCommand(char ch, unsigned &n_args, unsigned &vertices)
+{
+	switch (ch | 0x20) {
+	case 'm':
+	case 'l':
+		n_args = 2;
+		vertices = 1;
+		return true;
+
+	case 'h':
+	case 'v':
+		n_args = 1;
+		vertices = 1;
+		return true;
+
+	case 'z':
+		n_args = 0;
+		vertices = 1;
+		return true;
+
+	case 't':
+		n_args = 2;
+		vertices = CURVE_VERTICES;
+		return true;
+
+	case 's':
+	case 'q':
+		n_args = 4;
+		vertices = CURVE_VERTICES;
+		return true;
+
+	case 'c':
+		n_args = 6;
+		vertices = CURVE_VERTICES;
+		return true;
+
+	case 'a':
+		n_args = 7;
+		vertices = ARC_VERTICES;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Count the segments of a "d" attribute, including implicitly
+ * repeated commands.
+ */
+static void
+ScanPathData(const char *p, const char *end, SvgComplexity &c)
+{
+	unsigned n_args = 0, vertices = 0, args = 0;
+
+	while (p < end) {
+		const char ch = *p;
+		if (IsDigit(ch) || ch == '-' || ch == '+' || ch == '.') {
+			const char *next = SkipNumber(p, end);
+			p = next > p ? next : p + 1;
+
+			if (n_args > 0 && ++args == n_args) {
+				args = 0;
+				++c.path_segments;
+				c.vertices += vertices;
+			}
+		} else {
+			if (LookupPathCommand(ch, n_args, vertices)) {
+				args = 0;
+				if (n_args == 0) {
+					++c.path_segments;
+					c.vertices += vertices;
+				}
+			}
+
+			++p;
+		}
+	}
+}
+
+/**
+ * Scan the attributes of a start tag.
+ *
+ * @return the position after the tag
+ */
+static const char *
+ScanTag(const char *p, const char *end, bool path,
+	bool &empty, SvgComplexity &c)
+{
+	empty = false;
+
+	while (p < end) {
+		const char ch = *p;
+		if (ch == '>')
+			return p + 1;
+
+		if (ch == '/') {
+			empty = true;
+			++p;
+			continue;
+		}
+
+		if (IsWhitespace(ch)) {
+			++p;
+			continue;
+		}
+
+		const char *name = p;
+		while (p < end && IsNameChar(*p))
+			++p;
+		const bool is_d = p - name == 1 && *name == 'd';
+
+		while (p < end && (IsWhitespace(*p) || *p == '='))
+			++p;
+
+		if (p == end)
+			break;
+
+		const char quote = *p;
+		if (quote != '"' && quote != '\'')
+			continue;
+
+		const char *value = ++p;
+		const char *value_end = (const char *)memchr(p, quote, end - p);
+		if (value_end == nullptr)
+			value_end = end;
+
+		if (path && is_d)
+			ScanPathData(value, value_end, c);
+
+		p = value_end + (value_end < end);
+		empty = false;
+	}
+
+	return end;
+}
+
+SvgComplexity
+EstimateSvgComplexity(const char *data, size_t length) noexcept
+{
+	SvgComplexity c;
+	unsigned depth = 0;
+
+	const char *p = data, *const end = data + length;
+	while (true) {
+		p = (const char *)memchr(p, '<', end - p);
+		if (p == nullptr || ++p == end)
+			break;
+
+		if (*p == '/') {
+			if (depth > 0)
+				--depth;
+			p = SkipPast(p, end, ">");
+		} else if (*p == '?') {
+			p = SkipPast(p, end, "?>");
+		} else if (StartsWith(p, end, "!--")) {
+			p = SkipPast(p, end, "-->");
+		} else if (StartsWith(p, end, "![CDATA[")) {
+			p = SkipPast(p, end, "]]>");
+		} else if (*p == '!') {
+			/* declarations inside a DOCTYPE are found by
+			   the next iteration */
+			if (StartsWith(p, end, "!ENTITY"))
+				++c.entities;
+			++p;
+		} else {
+			const char *name = p;
+			while (p < end && IsNameChar(*p))
+				++p;
+
+			const size_t name_length = p - name;
+			auto is = [name, name_length](const char *s){
+				return name_length == strlen(s) &&
+					memcmp(name, s, name_length) == 0;
+			};
+
+			++c.elements;
+			if (is("circle"))
+				c.vertices += CIRCLE_VERTICES;
+			else if (is("rect"))
+				c.vertices += RECT_VERTICES;
+
+			bool empty;
+			p = ScanTag(p, end, is("path"), empty, c);
+			if (!empty && ++depth > c.max_depth)
+				c.max_depth = depth;
+		}
+	}
+
+	return c;
+}
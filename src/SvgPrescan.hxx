@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * Rough measures of the work needed to convert a document, obtained
+ * without parsing it.
+ */
+struct SvgComplexity {
+	size_t elements = 0;
+
+	unsigned max_depth = 0;
+
+	/**
+	 * The number of segments in all "d" attributes.
+	 */
+	size_t path_segments = 0;
+
+	/**
+	 * The estimated number of vertices after tessellation
+	 * (ignoring culling).
+	 */
+	size_t vertices = 0;
+
+	/**
+	 * The number of entity declarations, which may be used to
+	 * inflate the document.
+	 */
+	size_t entities = 0;
+};
+
+/**
+ * Estimate the complexity of the given SVG document with a single
+ * pass over the raw bytes, which is much faster than parsing it.  It
+ * is meant for routing conversion jobs to a suitable queue, and for
+ * rejecting obviously excessive documents early.  Malformed input is
+ * tolerated.
+ */
+gcc_pure
+SvgComplexity
+EstimateSvgComplexity(const char *data, size_t length) noexcept;
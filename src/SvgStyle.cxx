@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SvgStyle.hxx"
+#include "CssColor.hxx"
+#include "CssParser.hxx"
+#include "CssStylesheet.hxx"
+#include "PesColor.hxx"
+#include "ExpatUtil.hxx"
+
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+/**
+ * All attributes which may affect #SvgStyle.
+ */
+constexpr const char *style_attributes[] = {
+	"style",
+	"display", "visibility", "opacity",
+	"fill", "stroke", "fill-rule",
+};
+
+/**
+ * Look up properties in the "style" attribute (which is parsed
+ * lazily, only if it mentions the property), then in the matching
+ * style sheet rules and finally in the presentation attribute.
+ */
+class PropertyLookup {
+	const XML_Char **const atts;
+	const char *const style;
+
+	const CssStylesheet &stylesheet;
+	const ConstBuffer<unsigned> rules;
+
+	bool parsed = false;
+	std::map<std::string, std::string> css;
+
+public:
+	PropertyLookup(const XML_Char **_atts,
+		       const CssStylesheet &_stylesheet,
+		       ConstBuffer<unsigned> _rules)
+		:atts(_atts), style(FindXmlAttribute(atts, "style")),
+		 stylesheet(_stylesheet), rules(_rules) {}
+
+	const char *Get(const char *name);
+};
+
+const char *
+PropertyLookup::Get(const char *name)
+{
+	if (style != nullptr && strstr(style, name) != nullptr) {
+		if (!parsed) {
+			parsed = true;
+			try {
+				css = ParseCss(style);
+			} catch (...) {
+				fprintf(stderr, "Failed to parse CSS '%s'\n",
+					style);
+			}
+		}
+
+		auto i = css.find(name);
+		if (i != css.end())
+			return i->second.c_str();
+	}
+
+	for (size_t i = rules.size; i > 0; --i) {
+		const char *value = stylesheet.Get(rules[i - 1], name);
+		if (value != nullptr)
+			return value;
+	}
+
+	return FindXmlAttribute(atts, name);
+}
+
+void
+ApplyPaint(bool &enabled, Color &color, unsigned &pes_color,
+	   const char *value)
+{
+	if (strcmp(value, "none") == 0) {
+		enabled = false;
+		return;
+	}
+
+	try {
+		color = ParseCssColor(value);
+	} catch (...) {
+		fprintf(stderr, "Failed to parse color '%s'\n", value);
+		return;
+	}
+
+	pes_color = NearestPesColor(color);
+	enabled = true;
+}
+
+void
+ApplyFillRule(SvgStyle &style, const char *fill_rule)
+{
+	if (strcmp(fill_rule, "nonzero") == 0)
+		style.fill_rule = SvgFillRule::NONZERO;
+	else if (strcmp(fill_rule, "evenodd") == 0)
+		style.fill_rule = SvgFillRule::EVENODD;
+	else
+		fprintf(stderr, "Failed to parse fill-rule '%s'\n",
+			fill_rule);
+}
+
+} // anonymous namespace
+
+SvgStyle
+ResolveSvgStyle(const XML_Char **atts,
+		const CssStylesheet &stylesheet, ConstBuffer<unsigned> rules)
+{
+	PropertyLookup lookup(atts, stylesheet, rules);
+	SvgStyle style;
+
+	const char *display = lookup.Get("display");
+	const char *opacity = lookup.Get("opacity");
+	style.hidden = (display != nullptr && strcmp(display, "none") == 0) ||
+		(opacity != nullptr && strtod(opacity, nullptr) <= 0);
+
+	const char *visibility = lookup.Get("visibility");
+	if (visibility == nullptr)
+		style.visibility = SvgVisibility::INHERIT;
+	else if (strcmp(visibility, "hidden") == 0 ||
+		 strcmp(visibility, "collapse") == 0)
+		style.visibility = SvgVisibility::HIDDEN;
+	else if (strcmp(visibility, "visible") == 0)
+		style.visibility = SvgVisibility::VISIBLE;
+
+	const char *fill = lookup.Get("fill");
+	if (fill != nullptr)
+		ApplyPaint(style.fill, style.fill_color, style.fill_pes_color,
+			   fill);
+
+	const char *stroke = lookup.Get("stroke");
+	if (stroke != nullptr)
+		ApplyPaint(style.stroke, style.stroke_color,
+			   style.stroke_pes_color, stroke);
+
+	const char *fill_rule = lookup.Get("fill-rule");
+	if (fill_rule != nullptr)
+		ApplyFillRule(style, fill_rule);
+
+	return style;
+}
+
+const SvgStyle &
+SvgStyleCache::Get(const char *name, const XML_Char **atts,
+		   const CssStylesheet &stylesheet)
+{
+	stylesheet.Match(name, FindXmlAttribute(atts, "id"),
+			 FindXmlAttribute(atts, "class"), rules);
+
+	/* the key is the concatenation of all relevant attribute
+	   values and the indices of the matching rules (not the id or
+	   class attributes themselves, which are often unique); XML
+	   does not allow control characters in attributes, so they
+	   can serve as separators */
+	key.clear();
+	for (const char *attribute : style_attributes) {
+		const char *value = FindXmlAttribute(atts, attribute);
+		if (value != nullptr) {
+			key.append(value);
+			key.push_back('\0');
+		} else
+			key.push_back('\1');
+	}
+
+	key.append((const char *)rules.data(),
+		   rules.size() * sizeof(rules.front()));
+
+	auto i = map.find(key);
+	if (i == map.end()) {
+		const size_t entry_size = key.length() +
+			sizeof(*i) + 4 * sizeof(void *);
+		if (size + entry_size > max_size) {
+			map.clear();
+			size = 0;
+		}
+
+		i = map.emplace(key,
+				ResolveSvgStyle(atts, stylesheet,
+						{rules.data(), rules.size()})).first;
+		size += entry_size;
+	}
+
+	return i->second;
+}
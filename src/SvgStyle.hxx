@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "SvgData.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <expat.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+class CssStylesheet;
+
+enum class SvgVisibility : uint8_t {
+	INHERIT,
+	VISIBLE,
+	HIDDEN,
+};
+
+/**
+ * The presentation properties of an element which svg2pes
+ * evaluates, resolved from its "style" attribute and its
+ * presentation attributes.
+ */
+struct SvgStyle {
+	/**
+	 * Is the element (including its children) not rendered at
+	 * all ("display:none" or zero opacity)?
+	 */
+	bool hidden = false;
+
+	SvgVisibility visibility = SvgVisibility::INHERIT;
+
+	bool fill = false, stroke = false;
+
+	SvgFillRule fill_rule = SvgFillRule::NONZERO;
+
+	Color fill_color, stroke_color;
+
+	/**
+	 * The nearest entries in the PES color table.
+	 */
+	unsigned fill_pes_color = 0, stroke_pes_color = 0;
+
+	void ApplyTo(SvgPath &path) const {
+		path.fill = fill;
+		path.stroke = stroke;
+		path.fill_rule = fill_rule;
+		path.fill_color = fill_color;
+		path.stroke_color = stroke_color;
+		path.fill_pes_color = fill_pes_color;
+		path.stroke_pes_color = stroke_pes_color;
+	}
+};
+
+/**
+ * Resolve the style of an element.  Properties in the "style"
+ * attribute take precedence over style sheet rules, which take
+ * precedence over presentation attributes.  Malformed values are
+ * reported on stderr and ignored.
+ *
+ * @param rules the matching style sheet rules, ordered by increasing
+ * precedence (see CssStylesheet::Match())
+ */
+SvgStyle
+ResolveSvgStyle(const XML_Char **atts,
+		const CssStylesheet &stylesheet, ConstBuffer<unsigned> rules);
+
+/**
+ * Remembers the resolved style of each distinct combination of
+ * style-related attribute values and matching style sheet rules,
+ * because documents usually repeat the same few styles on thousands
+ * of elements.
+ */
+class SvgStyleCache {
+	std::unordered_map<std::string, SvgStyle> map;
+
+	/**
+	 * The approximate memory used by #map [bytes].
+	 */
+	size_t size = 0;
+
+	size_t max_size = SIZE_MAX;
+
+	/**
+	 * A buffer for building the lookup key; a member to avoid
+	 * reallocating it for each element.
+	 */
+	std::string key;
+
+	/**
+	 * A buffer for the matching style sheet rules.
+	 */
+	std::vector<unsigned> rules;
+
+public:
+	/**
+	 * Limit the (approximate) memory usage.  When it is reached,
+	 * the cache starts over empty.
+	 */
+	void SetMaxSize(size_t _max_size) {
+		max_size = _max_size;
+	}
+
+	/**
+	 * @return a reference which remains valid until the next
+	 * call
+	 */
+	const SvgStyle &Get(const char *name, const XML_Char **atts,
+			    const CssStylesheet &stylesheet);
+};
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "SvgTransform.hxx"
+
+#include <stdexcept>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+constexpr bool
+IsTransformSeparator(char ch) noexcept
+{
+	return ch == ' ' || ch == ',' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+const char *
+SkipSeparators(const char *s) noexcept
+{
+	while (IsTransformSeparator(*s))
+		++s;
+	return s;
+}
+
+/**
+ * Parse the argument list of a transform function, starting behind
+ * the opening parenthesis.
+ *
+ * @return the number of arguments
+ */
+unsigned
+ParseArguments(const char *&s, double *args, unsigned max_args)
+{
+	unsigned n = 0;
+	while (true) {
+		s = SkipSeparators(s);
+		if (*s == ')') {
+			++s;
+			return n;
+		}
+
+		if (n == max_args)
+			throw std::runtime_error("Too many transform arguments");
+
+		char *endptr;
+		args[n] = strtod(s, &endptr);
+		if (endptr == s || !isfinite(args[n]))
+			throw std::runtime_error("Malformed transform argument");
+		++n;
+		s = endptr;
+	}
+}
+
+constexpr double
+DegreesToRadians(double degrees) noexcept
+{
+	return degrees * M_PI / 180.;
+}
+
+SvgMatrix
+MakeTranslate(double x, double y) noexcept
+{
+	SvgMatrix m;
+	m.values[0][2] = x;
+	m.values[1][2] = y;
+	return m;
+}
+
+SvgMatrix
+MakeTransform(const char *name, size_t name_length,
+	      const double *args, unsigned n)
+{
+	SvgMatrix m;
+
+	auto is = [name, name_length](const char *expected){
+		return name_length == strlen(expected) &&
+			memcmp(name, expected, name_length) == 0;
+	};
+
+	if (is("matrix")) {
+		if (n != 6)
+			throw std::runtime_error("matrix() needs 6 arguments");
+
+		m.values[0][0] = args[0];
+		m.values[1][0] = args[1];
+		m.values[0][1] = args[2];
+		m.values[1][1] = args[3];
+		m.values[0][2] = args[4];
+		m.values[1][2] = args[5];
+	} else if (is("translate")) {
+		if (n != 1 && n != 2)
+			throw std::runtime_error("translate() needs 1 or 2 arguments");
+
+		m = MakeTranslate(args[0], n == 2 ? args[1] : 0);
+	} else if (is("scale")) {
+		if (n != 1 && n != 2)
+			throw std::runtime_error("scale() needs 1 or 2 arguments");
+
+		m.values[0][0] = args[0];
+		m.values[1][1] = n == 2 ? args[1] : args[0];
+	} else if (is("rotate")) {
+		if (n != 1 && n != 3)
+			throw std::runtime_error("rotate() needs 1 or 3 arguments");
+
+		const double angle = DegreesToRadians(args[0]);
+		m.values[0][0] = m.values[1][1] = cos(angle);
+		m.values[1][0] = sin(angle);
+		m.values[0][1] = -m.values[1][0];
+
+		if (n == 3)
+			/* rotate around the given center */
+			m = MakeTranslate(args[1], args[2]) * m *
+				MakeTranslate(-args[1], -args[2]);
+	} else if (is("skewX")) {
+		if (n != 1)
+			throw std::runtime_error("skewX() needs 1 argument");
+
+		m.values[0][1] = tan(DegreesToRadians(args[0]));
+	} else if (is("skewY")) {
+		if (n != 1)
+			throw std::runtime_error("skewY() needs 1 argument");
+
+		m.values[1][0] = tan(DegreesToRadians(args[0]));
+	} else
+		throw std::runtime_error("Failed to parse transform");
+
+	return m;
+}
+
+}
+
+SvgMatrix
+ParseSvgTransform(const char *s)
+{
+	SvgMatrix matrix;
+
+	while (*(s = SkipSeparators(s)) != 0) {
+		const char *name = s;
+		while ((*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z'))
+			++s;
+		const size_t name_length = s - name;
+
+		s = SkipSeparators(s);
+		if (*s != '(')
+			throw std::runtime_error("'(' expected");
+		++s;
+
+		double args[6];
+		const unsigned n = ParseArguments(s, args, 6);
+
+		/* the rightmost transformation is applied first */
+		matrix *= MakeTransform(name, name_length, args, n);
+	}
+
+	/* finite arguments can still overflow when multiplied */
+	for (const auto &row : matrix.values)
+		for (double value : row)
+			if (!isfinite(value))
+				throw std::runtime_error("Transform out of range");
+
+	return matrix;
+}
+
+const SvgMatrix &
+SvgTransformCache::Get(const char *s)
+{
+	auto i = map.find(s);
+	if (i == map.end()) {
+		/* the key, the value and the hash table node */
+		const size_t entry_size = strlen(s) +
+			sizeof(*i) + 4 * sizeof(void *);
+		if (size + entry_size > max_size) {
+			map.clear();
+			size = 0;
+		}
+
+		i = map.emplace(s, ParseSvgTransform(s)).first;
+		size += entry_size;
+	}
+
+	return i->second;
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "SvgMatrix.hxx"
+
+#include <string>
+#include <unordered_map>
+
+#include <stdint.h>
+
+/**
+ * Parse the value of a "transform" attribute (matrix, translate,
+ * scale, rotate, skewX and skewY).  Throws on error.
+ */
+SvgMatrix
+ParseSvgTransform(const char *s);
+
+/**
+ * Interns "transform" attribute values: each distinct string is
+ * parsed only once.
+ */
+class SvgTransformCache {
+	std::unordered_map<std::string, SvgMatrix> map;
+
+	/**
+	 * The approximate memory used by #map [bytes].
+	 */
+	size_t size = 0;
+
+	size_t max_size = SIZE_MAX;
+
+public:
+	/**
+	 * Limit the (approximate) memory usage.  When it is reached,
+	 * all entries are discarded.
+	 */
+	void SetMaxSize(size_t _max_size) {
+		max_size = _max_size;
+	}
+
+	/**
+	 * Throws on error.
+	 *
+	 * @return a reference which remains valid until the next
+	 * call
+	 */
+	const SvgMatrix &Get(const char *s);
+};
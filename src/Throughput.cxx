@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * End-to-end throughput benchmark: converts documents of each
+ * #SvgCorpusClass with svg2pes and compares the throughput and the
+ * peak memory usage with a baseline file.
+ *
+ * The throughput is stored relative to a reference kernel which is
+ * measured along with each class, so the baseline does not depend much on
+ * the speed of the machine.
+ */
+
+#include "SvgCorpus.hxx"
+#include "XorShiftRandom.hxx"
+#include "util/SystemError.hxx"
+#include "util/ScopeExit.hxx"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+namespace {
+
+struct Throughput {
+	/**
+	 * Input megabytes, vertices and stitches per second (or, in the
+	 * baseline, per run of the reference kernel).
+	 */
+	double megabytes, vertices, stitches;
+
+	/**
+	 * The peak resident set size [kB].
+	 */
+	unsigned long peak_rss;
+};
+
+struct Run {
+	double seconds;
+	unsigned long vertices, stitches;
+	unsigned long peak_rss;
+};
+
+static size_t reference_sink;
+
+/**
+ * Sort a few million pseudo-random numbers, which stresses the CPU
+ * and the memory similar to the converter.
+ *
+ * @return the best duration [s]
+ */
+double
+MeasureReference(unsigned n_runs)
+{
+	/* not from the heap: the allocator would keep the memory, and
+	   the forked converter would inherit it in its peak RSS */
+	constexpr size_t n = 1 << 21;
+	void *p = mmap(nullptr, n * sizeof(uint64_t), PROT_READ|PROT_WRITE,
+		       MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("mmap() failed");
+
+	AtScopeExit(p) { munmap(p, n * sizeof(uint64_t)); };
+	uint64_t *const v = (uint64_t *)p;
+
+	double best = 0;
+	for (unsigned i = 0; i < n_runs; ++i) {
+		XorShiftRandom random;
+		for (size_t j = 0; j < n; ++j)
+			v[j] = random.Next();
+
+		const auto start = std::chrono::steady_clock::now();
+		std::sort(v, v + n);
+		const std::chrono::duration<double> duration =
+			std::chrono::steady_clock::now() - start;
+
+		reference_sink += v[n / 2];
+
+		if (i == 0 || duration.count() < best)
+			best = duration.count();
+	}
+
+	return best;
+}
+
+/**
+ * Convert a throughput to units per run of the reference kernel.
+ */
+constexpr Throughput
+Relative(const Throughput &t, double reference)
+{
+	return {
+		t.megabytes * reference,
+		t.vertices * reference,
+		t.stitches * reference,
+		t.peak_rss,
+	};
+}
+
+/**
+ * Generate a document into a new temporary file.
+ *
+ * @return the path of the file, which must be deleted by the caller
+ */
+std::string
+GenerateFile(const SvgCorpusClass &c, unsigned scale, off_t &size_r)
+{
+	const char *tmpdir = getenv("TMPDIR");
+	std::string path = tmpdir != nullptr && *tmpdir != 0
+		? tmpdir : "/tmp";
+	path += "/svg2pes-";
+	path += c.name;
+	path += "-XXXXXX.svg";
+
+	int fd = mkstemps(&path.front(), 4);
+	if (fd < 0)
+		throw FormatErrno("Failed to create %s", path.c_str());
+
+	FILE *file = fdopen(fd, "w");
+	if (file == nullptr) {
+		close(fd);
+		unlink(path.c_str());
+		throw MakeErrno("fdopen() failed");
+	}
+
+	c.generate(file, scale);
+
+	const bool failed = fflush(file) != 0 || ferror(file);
+	size_r = ftello(file);
+	fclose(file);
+
+	if (failed) {
+		unlink(path.c_str());
+		throw FormatErrno("Failed to write %s", path.c_str());
+	}
+
+	return path;
+}
+
+/**
+ * Find "NAME = VALUE" in the output of "svg2pes --stats".
+ */
+unsigned long
+GetStatsValue(const std::string &stats, const char *name)
+{
+	const size_t length = strlen(name);
+	for (const char *p = stats.c_str(); p != nullptr;) {
+		if (strncmp(p, name, length) == 0 &&
+		    strncmp(p + length, " = ", 3) == 0)
+			return strtoul(p + length + 3, nullptr, 10);
+
+		p = strchr(p, '\n');
+		if (p != nullptr)
+			++p;
+	}
+
+	throw std::runtime_error(std::string("No \"") + name + "\" in svg2pes statistics");
+}
+
+/**
+ * Run the converter once and measure the wall time (including the
+ * process startup) and the peak memory usage.
+ */
+Run
+RunConverter(const char *svg2pes, const char *in_path)
+{
+	int fds[2];
+	if (pipe2(fds, O_CLOEXEC) < 0)
+		throw MakeErrno("pipe() failed");
+
+	const auto start = std::chrono::steady_clock::now();
+
+	const pid_t pid = fork();
+	if (pid < 0)
+		throw MakeErrno("fork() failed");
+
+	if (pid == 0) {
+		dup2(fds[1], STDERR_FILENO);
+		execl(svg2pes, svg2pes, "--stats", in_path, "/dev/null",
+		      nullptr);
+		fprintf(stderr, "Failed to execute %s: %s\n",
+			svg2pes, strerror(errno));
+		_exit(EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+
+	/* the statistics are printed at the end, so this reads until
+	   the process exits */
+	std::string output;
+	char buffer[4096];
+	ssize_t nbytes;
+	while ((nbytes = read(fds[0], buffer, sizeof(buffer))) > 0)
+		output.append(buffer, nbytes);
+	close(fds[0]);
+
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) < 0)
+		throw MakeErrno("wait4() failed");
+
+	const std::chrono::duration<double> duration =
+		std::chrono::steady_clock::now() - start;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		throw std::runtime_error("svg2pes failed: " + output);
+
+	Run run;
+	run.seconds = duration.count();
+	run.vertices = GetStatsValue(output, "vertices");
+	run.stitches = GetStatsValue(output, "stitches");
+	run.peak_rss = usage.ru_maxrss;
+	return run;
+}
+
+/**
+ * Convert a document of the given class several times and return
+ * the best result.
+ */
+Throughput
+Measure(const char *svg2pes, const SvgCorpusClass &c,
+	unsigned scale, unsigned n_runs)
+{
+	off_t size;
+	const std::string path = GenerateFile(c, scale, size);
+	AtScopeExit(&path) { unlink(path.c_str()); };
+
+	Run best = RunConverter(svg2pes, path.c_str());
+	for (unsigned i = 1; i < n_runs; ++i) {
+		const Run run = RunConverter(svg2pes, path.c_str());
+		best.seconds = std::min(best.seconds, run.seconds);
+		best.peak_rss = std::min(best.peak_rss, run.peak_rss);
+	}
+
+	return {
+		size / best.seconds / 1e6,
+		best.vertices / best.seconds,
+		best.stitches / best.seconds,
+		best.peak_rss,
+	};
+}
+
+using Baseline = std::map<std::string, Throughput>;
+
+Baseline
+LoadBaseline(const char *path)
+{
+	Baseline baseline;
+
+	FILE *file = fopen(path, "r");
+	if (file == nullptr) {
+		if (errno == ENOENT)
+			return baseline;
+		throw FormatErrno("Failed to open %s", path);
+	}
+
+	AtScopeExit(file) { fclose(file); };
+
+	char line[256];
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		if (*line == '#' || *line == '\n')
+			continue;
+
+		char name[64];
+		Throughput t;
+		if (sscanf(line, "%63s %lf %lf %lf %lu", name,
+			   &t.megabytes, &t.vertices, &t.stitches,
+			   &t.peak_rss) != 5)
+			throw std::runtime_error(std::string("Malformed line in baseline: ") + line);
+
+		baseline[name] = t;
+	}
+
+	return baseline;
+}
+
+void
+SaveBaseline(const char *path, const Baseline &baseline)
+{
+	FILE *file = fopen(path, "w");
+	if (file == nullptr)
+		throw FormatErrno("Failed to create %s", path);
+
+	fputs("# svg2pes throughput baseline, written by \"throughput --update\"\n"
+	      "# throughput per run of the reference kernel\n"
+	      "# class MB vertices stitches peak_rss_kB\n", file);
+	for (const auto &i : baseline)
+		fprintf(file, "%s %.6f %.0f %.0f %lu\n", i.first.c_str(),
+			i.second.megabytes, i.second.vertices,
+			i.second.stitches, i.second.peak_rss);
+
+	const bool failed = fflush(file) != 0 || ferror(file);
+	fclose(file);
+	if (failed)
+		throw FormatErrno("Failed to write %s", path);
+}
+
+/**
+ * Compare one value with the baseline and print a message if it
+ * regressed by more than the tolerance.
+ *
+ * @param higher_is_better true for throughput, false for memory
+ * @return false on regression
+ */
+bool
+Check(const char *class_name, const char *name, double value,
+      double baseline, double tolerance, bool higher_is_better)
+{
+	if (baseline <= 0)
+		return true;
+
+	const double ratio = value / baseline;
+	if (higher_is_better ? ratio >= 1 - tolerance : ratio <= 1 + tolerance)
+		return true;
+
+	fprintf(stderr, "%s: %s regressed: %.6g (baseline %.6g, %+.0f%%)\n",
+		class_name, name, value, baseline, (ratio - 1) * 100);
+	return false;
+}
+
+void
+Usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS] SVG2PES BASELINE [CLASS...]\n"
+		"\n"
+		"Options:\n"
+		"  --tolerance=F  allowed regression as a fraction (default 0.25)\n"
+		"  --scale=N      multiply the size of the documents\n"
+		"  --runs=N       convert each document N times (default 3)\n"
+		"  --update       write the results to BASELINE\n",
+		argv0);
+}
+
+unsigned
+ParseUnsigned(const char *s)
+{
+	char *endptr;
+	const unsigned long value = strtoul(s, &endptr, 10);
+	if (endptr == s || *endptr != 0 || value == 0)
+		throw std::runtime_error("Malformed number");
+	return value;
+}
+
+}
+
+int
+main(int argc, char **argv)
+try {
+	enum {
+		OPTION_TOLERANCE = 0x100,
+		OPTION_SCALE,
+		OPTION_RUNS,
+		OPTION_UPDATE,
+	};
+
+	static const struct option long_options[] = {
+		{"tolerance", required_argument, nullptr, OPTION_TOLERANCE},
+		{"scale", required_argument, nullptr, OPTION_SCALE},
+		{"runs", required_argument, nullptr, OPTION_RUNS},
+		{"update", no_argument, nullptr, OPTION_UPDATE},
+		{nullptr, 0, nullptr, 0}
+	};
+
+	double tolerance = 0.25;
+	unsigned scale = 1, n_runs = 3;
+	bool update = false;
+
+	int o;
+	while ((o = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+		switch (o) {
+		case OPTION_TOLERANCE:
+			{
+				char *endptr;
+				tolerance = strtod(optarg, &endptr);
+				if (endptr == optarg || *endptr != 0 ||
+				    !(tolerance >= 0 && tolerance < 1))
+					throw std::runtime_error("Malformed tolerance");
+			}
+			break;
+
+		case OPTION_SCALE:
+			scale = ParseUnsigned(optarg);
+			break;
+
+		case OPTION_RUNS:
+			n_runs = ParseUnsigned(optarg);
+			break;
+
+		case OPTION_UPDATE:
+			update = true;
+			break;
+
+		default:
+			Usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind < 2) {
+		Usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char *const svg2pes = argv[optind];
+	const char *const baseline_path = argv[optind + 1];
+
+	std::vector<const SvgCorpusClass *> classes;
+	if (argc - optind > 2) {
+		for (int i = optind + 2; i < argc; ++i) {
+			const auto *c = FindSvgCorpusClass(argv[i]);
+			if (c == nullptr)
+				throw std::runtime_error(std::string("Unknown class: ") + argv[i]);
+			classes.push_back(c);
+		}
+	} else {
+		for (const auto *i = svg_corpus_classes; i->name != nullptr; ++i)
+			classes.push_back(i);
+	}
+
+	Baseline baseline = LoadBaseline(baseline_path);
+
+	printf("%-10s %10s %12s %12s %12s\n", "class",
+	       "MB/s", "vertices/s", "stitches/s", "peak RSS kB");
+
+	bool ok = true;
+	for (const auto *c : classes) {
+		/* measure the reference next to each class, so a change
+		   of the machine's speed during the run affects both */
+		const Throughput t = Measure(svg2pes, *c, scale, n_runs);
+		const double reference = MeasureReference(n_runs);
+		printf("%-10s %10.3f %12.0f %12.0f %12lu\n", c->name,
+		       t.megabytes, t.vertices, t.stitches, t.peak_rss);
+		fflush(stdout);
+
+		const Throughput r = Relative(t, reference);
+
+		if (update) {
+			baseline[c->name] = r;
+			continue;
+		}
+
+		const auto i = baseline.find(c->name);
+		if (i == baseline.end())
+			continue;
+
+		const Throughput &b = i->second;
+		ok = Check(c->name, "MB", r.megabytes, b.megabytes,
+			   tolerance, true) && ok;
+		ok = Check(c->name, "vertices", r.vertices, b.vertices,
+			   tolerance, true) && ok;
+		ok = Check(c->name, "stitches", r.stitches, b.stitches,
+			   tolerance, true) && ok;
+		ok = Check(c->name, "peak RSS", r.peak_rss, b.peak_rss,
+			   tolerance, false) && ok;
+	}
+
+	if (update)
+		SaveBaseline(baseline_path, baseline);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+} catch (const std::exception &e) {
+	fprintf(stderr, "%s\n", e.what());
+	return EXIT_FAILURE;
+}
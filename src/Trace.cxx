@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "Trace.hxx"
+
+#ifdef ENABLE_TRACE
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+std::atomic<bool> trace_enabled{false};
+
+namespace {
+
+struct TraceEvent {
+	uint64_t start, duration;
+	unsigned long count;
+	const char *category;
+
+	/**
+	 * The Chrome trace event type: 'X' (complete), 'B' (begin) or
+	 * 'E' (end).
+	 */
+	char phase;
+
+	/* copies of the strings, which are usually transient
+	   (e.g. pointers into the XML parser's buffer) */
+	char name[24];
+	char id[40];
+};
+
+/**
+ * The events of one thread.  Only the owning thread writes to it;
+ * it is read at exit.
+ */
+struct TraceBuffer {
+	static constexpr size_t CAPACITY = 1 << 16;
+
+	const unsigned tid;
+
+	/**
+	 * The number of events ever recorded; the oldest ones have
+	 * been overwritten if this exceeds #CAPACITY.  An event is
+	 * counted only after it has been filled in.
+	 */
+	std::atomic<uint64_t> n_events{0};
+
+	std::unique_ptr<TraceEvent[]> events;
+
+	explicit TraceBuffer(unsigned _tid)
+		:tid(_tid), events(new TraceEvent[CAPACITY]) {}
+
+	/**
+	 * Return the slot for the next event; call Commit() after
+	 * filling it in.
+	 */
+	TraceEvent &Next() noexcept {
+		return events[n_events.load(std::memory_order_relaxed) % CAPACITY];
+	}
+
+	void Commit() noexcept {
+		/* only this thread writes, so no read-modify-write
+		   is needed */
+		n_events.store(n_events.load(std::memory_order_relaxed) + 1,
+			       std::memory_order_release);
+	}
+};
+
+std::chrono::steady_clock::time_point trace_start;
+
+const char *trace_path;
+
+/**
+ * All buffers ever created.  They are never freed, so events of
+ * threads which have exited can still be written.
+ */
+std::mutex trace_buffers_mutex;
+std::vector<TraceBuffer *> trace_buffers;
+
+/**
+ * The buffer of the current thread; nullptr until
+ * EnableThreadTrace() has been called.  It is allocated then and not
+ * when the first event is recorded, because recording must not
+ * fail.
+ */
+thread_local TraceBuffer *thread_trace_buffer = nullptr;
+
+void
+CopyString(char *dest, size_t size, const char *src) noexcept
+{
+	const size_t length = std::min(strlen(src), size - 1);
+	memcpy(dest, src, length);
+	dest[length] = 0;
+}
+
+void
+WriteJsonString(FILE *file, const char *s)
+{
+	putc('"', file);
+	for (; *s != 0; ++s) {
+		const unsigned char ch = *s;
+		if (ch == '"' || ch == '\\')
+			fprintf(file, "\\%c", ch);
+		else if (ch < 0x20)
+			fprintf(file, "\\u%04x", ch);
+		else
+			putc(ch, file);
+	}
+	putc('"', file);
+}
+
+void
+WriteEvent(FILE *file, unsigned tid, const TraceEvent &e, bool &first)
+{
+	fputs(first ? "\n" : ",\n", file);
+	first = false;
+
+	fputs("{\"name\":", file);
+	WriteJsonString(file, e.name);
+	fprintf(file, ",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,"
+		"\"ts\":%.3f",
+		e.category, e.phase, tid, e.start / 1000.);
+
+	if (e.phase == 'E') {
+		fputs("}", file);
+		return;
+	}
+
+	if (e.phase == 'X')
+		fprintf(file, ",\"dur\":%.3f", e.duration / 1000.);
+
+	fputs(",\"args\":{", file);
+
+	if (e.id[0] != 0) {
+		fputs("\"id\":", file);
+		WriteJsonString(file, e.id);
+		fputs(",", file);
+	}
+
+	fprintf(file, "\"count\":%lu}}", e.count);
+}
+
+void
+WriteTrace(FILE *file)
+{
+	const std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+
+	bool first = true;
+	for (const auto *buffer : trace_buffers) {
+		const uint64_t n =
+			buffer->n_events.load(std::memory_order_acquire);
+		const uint64_t begin = n > TraceBuffer::CAPACITY
+			? n - TraceBuffer::CAPACITY
+			: 0;
+
+		for (uint64_t i = begin; i < n; ++i)
+			WriteEvent(file, buffer->tid,
+				   buffer->events[i % TraceBuffer::CAPACITY],
+				   first);
+	}
+
+	fputs("\n]}\n", file);
+}
+
+void
+WriteTraceAtExit()
+{
+	trace_enabled = false;
+
+	FILE *file = fopen(trace_path, "w");
+	if (file == nullptr) {
+		perror(trace_path);
+		return;
+	}
+
+	WriteTrace(file);
+	fclose(file);
+}
+
+void
+RecordEvent(char phase, const char *category, const char *name,
+	    const char *id, uint64_t start, uint64_t duration,
+	    unsigned long count) noexcept
+{
+	TraceBuffer *const buffer = thread_trace_buffer;
+	if (buffer == nullptr)
+		/* EnableThreadTrace() was not called in this thread */
+		return;
+
+	auto &e = buffer->Next();
+	e.start = start;
+	e.duration = duration;
+	e.count = count;
+	e.category = category;
+	e.phase = phase;
+	CopyString(e.name, sizeof(e.name), name);
+	CopyString(e.id, sizeof(e.id), id != nullptr ? id : "");
+	buffer->Commit();
+}
+
+} // anonymous namespace
+
+void
+EnableTrace(const char *path)
+{
+	trace_path = path;
+	trace_start = std::chrono::steady_clock::now();
+	trace_enabled = true;
+	EnableThreadTrace();
+	atexit(WriteTraceAtExit);
+}
+
+void
+EnableThreadTrace()
+{
+	if (!IsTraceEnabled() || thread_trace_buffer != nullptr)
+		return;
+
+	const std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+	std::unique_ptr<TraceBuffer>
+		buffer(new TraceBuffer(trace_buffers.size() + 1));
+	trace_buffers.push_back(buffer.get());
+	thread_trace_buffer = buffer.release();
+}
+
+uint64_t
+GetTraceClock() noexcept
+{
+	const auto elapsed = std::chrono::steady_clock::now() - trace_start;
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void
+TraceSpan::Commit() noexcept
+{
+	const uint64_t end = GetTraceClock();
+	RecordEvent('X', category, name, id, start, end - start, count);
+}
+
+void
+TraceBegin(const char *category, const char *name, const char *id) noexcept
+{
+	RecordEvent('B', category, name, id, GetTraceClock(), 0, 0);
+}
+
+void
+TraceEnd(const char *category) noexcept
+{
+	RecordEvent('E', category, "", nullptr, GetTraceClock(), 0, 0);
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "Compiler.h"
+
+#include <stdint.h>
+
+/*
+ * Optional tracing of spans (phases, elements, ...) which can be
+ * loaded into chrome://tracing or Perfetto.  Tracing is compiled in
+ * with -DENABLE_TRACE (Meson option "trace"); if it is, it still
+ * costs only one predictable branch per span unless EnableTrace() was
+ * called.
+ *
+ * Each thread records into its own ring buffer without locking; only
+ * the newest events are kept if a buffer overflows.
+ */
+
+#ifdef ENABLE_TRACE
+
+#include <atomic>
+
+extern std::atomic<bool> trace_enabled;
+
+/**
+ * Start tracing in the calling thread.  The trace is written to the
+ * given file when the process exits.
+ */
+void
+EnableTrace(const char *path);
+
+/**
+ * Start tracing in another thread (if EnableTrace() has been
+ * called); call this at the start of each thread.  Events of threads
+ * which have not done so are discarded.
+ */
+void
+EnableThreadTrace();
+
+static inline bool
+IsTraceEnabled() noexcept
+{
+	return trace_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @return the current time in nanoseconds
+ */
+uint64_t
+GetTraceClock() noexcept;
+
+/**
+ * A span which is recorded when this object is destructed.  The
+ * strings must remain valid until then.
+ */
+class TraceSpan {
+	const char *const category, *const name;
+	const char *id = nullptr;
+	unsigned long count = 0;
+	uint64_t start;
+	const bool active;
+
+public:
+	TraceSpan(const char *_category, const char *_name) noexcept
+		:category(_category), name(_name),
+		 active(IsTraceEnabled()) {
+		if (gcc_unlikely(active))
+			start = GetTraceClock();
+	}
+
+	~TraceSpan() noexcept {
+		if (gcc_unlikely(active))
+			Commit();
+	}
+
+	TraceSpan(const TraceSpan &) = delete;
+	TraceSpan &operator=(const TraceSpan &) = delete;
+
+	/**
+	 * Attach an identifier, e.g. the "id" attribute of an
+	 * element.  May be nullptr.
+	 */
+	void SetId(const char *_id) noexcept {
+		id = _id;
+	}
+
+	/**
+	 * Attach a number, e.g. the number of vertices.
+	 */
+	void SetCount(unsigned long _count) noexcept {
+		count = _count;
+	}
+
+private:
+	void Commit() noexcept;
+};
+
+/**
+ * Record the beginning of a span which is ended by TraceEnd() in the
+ * same thread, e.g. at the end tag of an XML element.  Unlike with
+ * #TraceSpan, the strings are copied immediately.  Only call this if
+ * IsTraceEnabled().
+ */
+void
+TraceBegin(const char *category, const char *name, const char *id) noexcept;
+
+/**
+ * Record the end of the innermost span started by TraceBegin().
+ */
+void
+TraceEnd(const char *category) noexcept;
+
+#else
+
+static constexpr bool
+IsTraceEnabled() noexcept
+{
+	return false;
+}
+
+class TraceSpan {
+public:
+	TraceSpan(const char *, const char *) noexcept {}
+
+	void SetId(const char *) noexcept {}
+	void SetCount(unsigned long) noexcept {}
+};
+
+static inline void
+EnableThreadTrace()
+{
+}
+
+static inline void
+TraceBegin(const char *, const char *, const char *) noexcept
+{
+}
+
+static inline void
+TraceEnd(const char *) noexcept
+{
+}
+
+#endif
@@ -0,0 +1,471 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "XmlTokenizer.hxx"
+#include "Compiler.h"
+
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+namespace {
+
+constexpr bool
+IsXmlWhitespace(char ch) noexcept
+{
+	return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+constexpr bool
+IsXmlNameEnd(char ch) noexcept
+{
+	return IsXmlWhitespace(ch) || ch == '/' || ch == '>' || ch == '=';
+}
+
+gcc_pure
+bool
+IsBlank(const char *s, const char *end) noexcept
+{
+	for (; s != end; ++s)
+		if (!IsXmlWhitespace(*s))
+			return false;
+
+	return true;
+}
+
+/**
+ * Replace line breaks and tabs in an attribute value with spaces, as
+ * required by the XML specification.  Only these characters are
+ * written, because each write to a private file mapping copies the
+ * page.
+ */
+void
+NormalizeWhitespace(char *s, char *end) noexcept
+{
+	for (const char *ch = "\t\n\r"; *ch != 0; ++ch)
+		for (char *p = s;
+		     (p = (char *)memchr(p, *ch, end - p)) != nullptr; ++p)
+			*p = ' ';
+}
+
+/**
+ * Encode a code point as UTF-8.
+ *
+ * @return the end of the encoded sequence
+ */
+char *
+EncodeUtf8(char *p, unsigned long ch) noexcept
+{
+	if (ch < 0x80) {
+		*p++ = char(ch);
+	} else if (ch < 0x800) {
+		*p++ = char(0xc0 | (ch >> 6));
+		*p++ = char(0x80 | (ch & 0x3f));
+	} else if (ch < 0x10000) {
+		*p++ = char(0xe0 | (ch >> 12));
+		*p++ = char(0x80 | ((ch >> 6) & 0x3f));
+		*p++ = char(0x80 | (ch & 0x3f));
+	} else {
+		*p++ = char(0xf0 | (ch >> 18));
+		*p++ = char(0x80 | ((ch >> 12) & 0x3f));
+		*p++ = char(0x80 | ((ch >> 6) & 0x3f));
+		*p++ = char(0x80 | (ch & 0x3f));
+	}
+
+	return p;
+}
+
+gcc_noreturn
+void
+Fail(const char *msg)
+{
+	throw XmlTokenizerError(msg);
+}
+
+/**
+ * Decode the entity reference between "&" and ";" into the given
+ * buffer.  The result is never longer than the reference.
+ */
+char *
+DecodeEntity(char *out, const char *name, size_t length)
+{
+	if (length == 2 && memcmp(name, "lt", 2) == 0)
+		*out++ = '<';
+	else if (length == 2 && memcmp(name, "gt", 2) == 0)
+		*out++ = '>';
+	else if (length == 3 && memcmp(name, "amp", 3) == 0)
+		*out++ = '&';
+	else if (length == 4 && memcmp(name, "quot", 4) == 0)
+		*out++ = '"';
+	else if (length == 4 && memcmp(name, "apos", 4) == 0)
+		*out++ = '\'';
+	else if (length >= 2 && name[0] == '#') {
+		const bool hex = name[1] == 'x';
+		const char *digits = name + 1 + hex;
+		char *endptr;
+		const unsigned long ch = strtoul(digits, &endptr, hex ? 16 : 10);
+		if (endptr == digits || endptr != name + length ||
+		    ch == 0 || ch > 0x10ffff)
+			Fail("Malformed character reference");
+
+		out = EncodeUtf8(out, ch);
+	} else
+		Fail("Unsupported entity reference");
+
+	return out;
+}
+
+/**
+ * Decode all entity references in place.
+ *
+ * @return the new end of the string
+ */
+char *
+DecodeEntities(char *s, char *end)
+{
+	char *in = (char *)memchr(s, '&', end - s);
+	if (in == nullptr)
+		return end;
+
+	char *out = in;
+	while (true) {
+		char *semicolon = (char *)memchr(in, ';', end - in);
+		if (semicolon == nullptr)
+			Fail("Malformed entity reference");
+
+		out = DecodeEntity(out, in + 1, semicolon - in - 1);
+		in = semicolon + 1;
+
+		char *next = (char *)memchr(in, '&', end - in);
+		char *chunk_end = next != nullptr ? next : end;
+		memmove(out, in, chunk_end - in);
+		out += chunk_end - in;
+		if (next == nullptr)
+			return out;
+
+		in = next;
+	}
+}
+
+class InSituTokenizer {
+	char *p;
+	char *const end;
+
+	XmlTokenizerHandler &handler;
+
+	/**
+	 * The names of all open elements.
+	 */
+	std::vector<const char *> stack;
+
+	std::vector<const char *> atts;
+
+	bool seen_root = false;
+
+public:
+	InSituTokenizer(char *data, size_t length,
+			XmlTokenizerHandler &_handler)
+		:p(data), end(data + length), handler(_handler) {}
+
+	void Run();
+
+private:
+	char Peek() const {
+		if (p == end)
+			Fail("Unexpected end of document");
+		return *p;
+	}
+
+	bool StartsWith(const char *prefix, size_t length) const noexcept {
+		return size_t(end - p) >= length &&
+			memcmp(p, prefix, length) == 0;
+	}
+
+	void SkipWhitespace() noexcept {
+		while (p != end && IsXmlWhitespace(*p))
+			++p;
+	}
+
+	/**
+	 * Move #p behind the given string.
+	 */
+	char *SkipPast(const char *s, size_t length) {
+		char *found = (char *)memmem(p, end - p, s, length);
+		if (found == nullptr)
+			Fail("Unexpected end of document");
+
+		p = found + length;
+		return found;
+	}
+
+	/**
+	 * Move #p to the end of a name.
+	 */
+	void SkipName() {
+		const char *start = p;
+		while (p != end && !IsXmlNameEnd(*p))
+			++p;
+
+		if (p == start)
+			Fail("Name expected");
+	}
+
+	void Text(char *s, char *text_end);
+	void ProcessingInstruction();
+	void Doctype();
+	void StartTag();
+	void EndTag();
+};
+
+void
+InSituTokenizer::Text(char *s, char *text_end)
+{
+	if (stack.empty()) {
+		if (!IsBlank(s, text_end))
+			Fail("Text outside of the document element");
+		return;
+	}
+
+	if (handler.WantXmlCharacterData()) {
+		text_end = DecodeEntities(s, text_end);
+		if (text_end > s)
+			handler.OnXmlCharacterData(s, text_end - s);
+	}
+}
+
+void
+InSituTokenizer::ProcessingInstruction()
+{
+	/* p points behind "<?" */
+	const char *start = p;
+	const char *pi_end = SkipPast("?>", 2);
+
+	if (pi_end - start < 4 || memcmp(start, "xml", 3) != 0 ||
+	    !IsXmlWhitespace(start[3]))
+		return;
+
+	/* the XML declaration: only UTF-8 (and its subset ASCII) is
+	   supported */
+	const char *encoding = (const char *)
+		memmem(start, pi_end - start, "encoding", 8);
+	if (encoding == nullptr)
+		return;
+
+	const char *value = encoding + 8;
+	while (value < pi_end && (IsXmlWhitespace(*value) || *value == '='))
+		++value;
+
+	if (value >= pi_end || (*value != '"' && *value != '\''))
+		Fail("Malformed XML declaration");
+
+	const char quote = *value++;
+	const char *value_end = (const char *)
+		memchr(value, quote, pi_end - value);
+	if (value_end == nullptr)
+		Fail("Malformed XML declaration");
+
+	const size_t length = value_end - value;
+	if (!(length == 5 && strncasecmp(value, "utf-8", 5) == 0) &&
+	    !(length == 8 && strncasecmp(value, "us-ascii", 8) == 0))
+		Fail("Unsupported encoding");
+}
+
+void
+InSituTokenizer::Doctype()
+{
+	/* entities declared in an internal subset would have to be
+	   expanded */
+	for (; p != end; ++p) {
+		if (*p == '[')
+			Fail("Internal DTD subset is not supported");
+
+		if (*p == '>') {
+			++p;
+			return;
+		}
+	}
+
+	Fail("Unexpected end of document");
+}
+
+void
+InSituTokenizer::StartTag()
+{
+	if (seen_root && stack.empty())
+		Fail("Junk after document element");
+
+	char *const name = p;
+	SkipName();
+	char *const name_end = p;
+
+	atts.clear();
+
+	bool empty = false;
+	while (true) {
+		SkipWhitespace();
+
+		const char ch = Peek();
+		if (ch == '>') {
+			++p;
+			break;
+		}
+
+		if (ch == '/') {
+			++p;
+			if (Peek() != '>')
+				Fail("'>' expected");
+			++p;
+			empty = true;
+			break;
+		}
+
+		char *const attribute = p;
+		SkipName();
+		char *const attribute_end = p;
+
+		SkipWhitespace();
+		if (Peek() != '=')
+			Fail("'=' expected");
+		++p;
+		SkipWhitespace();
+
+		const char quote = Peek();
+		if (quote != '"' && quote != '\'')
+			Fail("Quote expected");
+
+		char *const value = ++p;
+		char *const quote_end = (char *)memchr(p, quote, end - p);
+		if (quote_end == nullptr)
+			Fail("Unexpected end of document");
+		p = quote_end + 1;
+
+		if (p != end && !IsXmlNameEnd(*p))
+			Fail("Malformed attribute");
+
+		NormalizeWhitespace(value, quote_end);
+		*DecodeEntities(value, quote_end) = 0;
+
+		/* the character after the name has already been
+		   consumed */
+		*attribute_end = 0;
+
+		atts.push_back(attribute);
+		atts.push_back(value);
+	}
+
+	atts.push_back(nullptr);
+	*name_end = 0;
+
+	seen_root = true;
+	handler.OnXmlStartElement(name, atts.data());
+
+	if (empty)
+		handler.OnXmlEndElement(name);
+	else
+		stack.push_back(name);
+}
+
+void
+InSituTokenizer::EndTag()
+{
+	char *const name = p;
+	SkipName();
+	char *const name_end = p;
+
+	SkipWhitespace();
+	if (Peek() != '>')
+		Fail("'>' expected");
+	++p;
+
+	*name_end = 0;
+	if (stack.empty() || strcmp(stack.back(), name) != 0)
+		Fail("Mismatched tag");
+
+	stack.pop_back();
+	handler.OnXmlEndElement(name);
+}
+
+void
+InSituTokenizer::Run()
+{
+	if (StartsWith("\xef\xbb\xbf", 3))
+		p += 3;
+	else if (StartsWith("\xfe\xff", 2) || StartsWith("\xff\xfe", 2))
+		Fail("UTF-16 is not supported");
+
+	while (true) {
+		char *lt = (char *)memchr(p, '<', end - p);
+		Text(p, lt != nullptr ? lt : end);
+		if (lt == nullptr)
+			break;
+
+		p = lt + 1;
+		switch (Peek()) {
+		case '?':
+			++p;
+			ProcessingInstruction();
+			break;
+
+		case '!':
+			if (StartsWith("!--", 3)) {
+				p += 3;
+				SkipPast("-->", 3);
+			} else if (StartsWith("![CDATA[", 8)) {
+				if (stack.empty())
+					Fail("CDATA outside of the document element");
+
+				char *start = p += 8;
+				char *cdata_end = SkipPast("]]>", 3);
+				if (cdata_end > start &&
+				    handler.WantXmlCharacterData())
+					handler.OnXmlCharacterData(start,
+								   cdata_end - start);
+			} else if (StartsWith("!DOCTYPE", 8)) {
+				p += 8;
+				Doctype();
+			} else
+				Fail("Malformed markup declaration");
+			break;
+
+		case '/':
+			++p;
+			EndTag();
+			break;
+
+		default:
+			StartTag();
+			break;
+		}
+	}
+
+	if (!stack.empty())
+		Fail("Unclosed element");
+
+	if (!seen_root)
+		Fail("No document element");
+}
+
+} // anonymous namespace
+
+void
+TokenizeXmlInSitu(char *data, size_t length, XmlTokenizerHandler &handler)
+{
+	InSituTokenizer(data, length, handler).Run();
+}
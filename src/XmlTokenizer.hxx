@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <stdexcept>
+
+#include <stddef.h>
+
+/**
+ * The document cannot be handled by TokenizeXmlInSitu(), either
+ * because it is malformed or because it uses an XML feature which is
+ * not implemented.  Expat may still be able to parse it.
+ */
+class XmlTokenizerError final : public std::runtime_error {
+public:
+	explicit XmlTokenizerError(const char *msg)
+		:std::runtime_error(msg) {}
+};
+
+class XmlTokenizerHandler {
+public:
+	virtual void OnXmlStartElement(const char *name,
+				       const char **atts) = 0;
+	virtual void OnXmlEndElement(const char *name) = 0;
+	virtual void OnXmlCharacterData(const char *s, size_t length) = 0;
+
+	/**
+	 * Shall character data be decoded and passed to
+	 * OnXmlCharacterData()?  This is asked for each text node,
+	 * so the answer may change while the document is parsed.
+	 */
+	virtual bool WantXmlCharacterData() const noexcept = 0;
+};
+
+/**
+ * Parse a complete XML document in place.  Names and attribute
+ * values are null-terminated and entity references are decoded
+ * inside the buffer, so the handler receives pointers into it and
+ * nothing is copied; a private writable file mapping is the intended
+ * input.
+ *
+ * Only UTF-8 documents without an internal DTD subset are supported,
+ * and well-formedness is checked only as far as it is cheap (tag
+ * nesting, quoting, entity names).  Throws #XmlTokenizerError if the
+ * document is rejected; the handler may have been invoked already.
+ */
+void
+TokenizeXmlInSitu(char *data, size_t length, XmlTokenizerHandler &handler);
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2017 Max Kellermann <max.kellermann@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * A xorshift pseudo random number generator; unlike std::rand(), its
+ * sequence is the same on all platforms, which makes it suitable for
+ * generating reproducible benchmark inputs.
+ */
+class XorShiftRandom {
+	uint64_t state;
+
+public:
+	explicit constexpr XorShiftRandom(uint64_t seed=0x9e3779b97f4a7c15)
+		:state(seed != 0 ? seed : 1) {}
+
+	uint64_t Next() noexcept {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+
+	/**
+	 * Returns a number in the range [0, n).
+	 */
+	unsigned Next(unsigned n) noexcept {
+		return unsigned(Next() % n);
+	}
+
+	/**
+	 * Returns a number in the range [min, max).
+	 */
+	double Next(double min, double max) noexcept {
+		return min + (max - min) * double(Next() >> 11) / double(1ull << 53);
+	}
+};
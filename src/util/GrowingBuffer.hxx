@@ -104,7 +104,7 @@ public:
 	}
 
 	constexpr const_iterator begin() const {
-		return array.cbegin();
+		return array.begin();
 	}
 
 	iterator end() {
@@ -116,7 +116,19 @@ public:
 	}
 
 	constexpr operator ConstBuffer<T>() const {
-		return {&front(), size()};
+		return {begin(), size()};
+	}
+
+	void clear() {
+		the_size = 0;
+	}
+
+	/**
+	 * Like clear(), but also free the memory.
+	 */
+	void reset() {
+		array = Array();
+		the_size = 0;
 	}
 
 	T *PrepareWrite(size_type n) {